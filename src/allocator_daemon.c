@@ -0,0 +1,732 @@
+/**
+ * Daemon serving the Banker's algorithm to real jobs over a Unix domain
+ * socket. Connections are multiplexed by a single epoll loop, which
+ * keeps the resident state in a ResourceManager and decides the
+ * requests read in one pass together
+ **/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "allocator_daemon.h"
+#include "resource_manager.h"
+
+/* Longest message, and number of events taken per wait */
+#define DAEMON_LINE_MAX 4096
+#define DAEMON_EVENTS 64
+
+/* Connection of a job */
+typedef struct Client {
+    int fd;
+    int pid;
+    bool waiting;
+    bool told_wait;
+    bool hangup;
+    bool dirty;
+    bool closed;
+    unsigned int events;
+    int *request;
+    char in[DAEMON_LINE_MAX];
+    size_t in_used;
+    char *out;
+    size_t out_used;
+    size_t out_capacity;
+    TAILQ_ENTRY(Client) clients;
+} Client;
+
+TAILQ_HEAD(client_list, Client);
+
+/* State of the daemon. A client with a request is in exactly one of the
+ * batch read since the last decision and the waiters denied until a
+ * release */
+typedef struct Daemon {
+    ResourceManager *rm;
+    int num_resources;
+    int capacity;
+    int epoll_fd;
+    struct client_list clients;
+    Client **jobs;
+    Client **batch;
+    int batch_count;
+    Client **waiters;
+    int waiters_count;
+    Client **deciding;
+    int *pids;
+    const int **requests;
+    RmStatus *statuses;
+    Client **dirty;
+    int dirty_count;
+    int dirty_capacity;
+    bool released;
+    long connections;
+    long messages;
+    long requests_count;
+    long batches;
+    long decided;
+    long waits;
+} Daemon;
+
+static volatile sig_atomic_t stop_daemon = 0;
+
+/* Function to stop the event loop on SIGINT or SIGTERM */
+static void handle_signal(int signal) {
+
+    (void) signal;
+    stop_daemon = 1;
+}
+
+/* Function to allocate zeroed memory, exiting when there is none */
+static void *allocate_zeroed(size_t count, size_t size) {
+
+    void *data = calloc(count, size);
+
+    if (data == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    return data;
+}
+
+/* Function to queue a client to be flushed at the end of the pass */
+static void mark_dirty(Daemon *d, Client *c) {
+
+    if (c->dirty) {
+        return;
+    }
+
+    if (d->dirty_count == d->dirty_capacity) {
+        d->dirty_capacity = d->dirty_capacity == 0 ? 64 :
+                            d->dirty_capacity * 2;
+        d->dirty = realloc(d->dirty, d->dirty_capacity * sizeof(Client *));
+        if (d->dirty == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+
+    c->dirty = true;
+    d->dirty[d->dirty_count++] = c;
+}
+
+/* Function to append a reply to the output of a client */
+static void reply(Daemon *d, Client *c, const char *format, ...) {
+
+    int length;
+    char line[64];
+    va_list args;
+
+    va_start(args, format);
+    length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (c->out_used + length > c->out_capacity) {
+        c->out_capacity = (c->out_used + length) * 2;
+        c->out = realloc(c->out, c->out_capacity);
+        if (c->out == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+
+    memcpy(c->out + c->out_used, line, length);
+    c->out_used += length;
+    mark_dirty(d, c);
+}
+
+/* Function to read up to num_resources values separated by spaces,
+ * missing values being 0. Returns -1 if the values are malformed */
+static int parse_values(Daemon *d, const char *text, int *values) {
+
+    int count = 0;
+    long value;
+    char *end;
+
+    memset(values, 0, d->num_resources * sizeof(int));
+
+    while (true) {
+
+        while (*text == ' ' || *text == '\t') {
+            text++;
+        }
+
+        if (*text == '\0') {
+            return 0;
+        }
+
+        if (!isdigit((unsigned char) *text) || count == d->num_resources) {
+            return -1;
+        }
+
+        value = strtol(text, &end, 10);
+        if (value > INT_MAX) {
+            return -1;
+        }
+
+        values[count++] = value;
+        text = end;
+    }
+}
+
+/* Function to set the events a client is polled for. Input is not read
+ * while a request waits with a full buffer, and output is polled for
+ * while some is left to write */
+static void update_events(Daemon *d, Client *c) {
+
+    unsigned int events = 0;
+    struct epoll_event event;
+
+    if (!c->hangup && !(c->waiting && c->in_used == DAEMON_LINE_MAX)) {
+        events |= EPOLLIN;
+    }
+
+    if (c->out_used > 0) {
+        events |= EPOLLOUT;
+    }
+
+    if (events != c->events) {
+        event.events = events;
+        event.data.ptr = c;
+        epoll_ctl(d->epoll_fd, EPOLL_CTL_MOD, c->fd, &event);
+        c->events = events;
+    }
+}
+
+/* Function to end the job of a client, releasing what it holds */
+static void end_job(Daemon *d, Client *c) {
+
+    rm_exit(d->rm, c->pid);
+    d->jobs[c->pid] = NULL;
+    c->pid = -1;
+    d->released = true;
+}
+
+/* Function to remove a client from a list of clients with requests */
+static void remove_request(Client **list, int *count, Client *c) {
+
+    int i;
+
+    for (i = 0; i < *count && list[i] != c; i++);
+    if (i < *count) {
+        memmove(list + i, list + i + 1, (*count - i - 1) * sizeof(Client *));
+        (*count)--;
+    }
+}
+
+/* Function to answer a message. Requests are answered when the batch
+ * they join is decided */
+static void handle_message(Daemon *d, Client *c, char *line) {
+
+    int pid;
+    char *operand;
+
+    operand = line + strcspn(line, " \t");
+    if (*operand != '\0') {
+        *operand++ = '\0';
+    }
+
+    if (*line == '\0') {
+        return;
+    }
+
+    d->messages++;
+
+    if (strcmp(line, "REGISTER") == 0) {
+
+        if (c->pid != -1 || parse_values(d, operand, c->request) == -1) {
+            reply(d, c, "DENIED\n");
+            return;
+        }
+
+        for (pid = 0; pid < d->capacity && d->jobs[pid] != NULL; pid++);
+
+        /* the daemon is full or the max need exceeds the totals */
+        if (pid == d->capacity ||
+            rm_register(d->rm, pid, c->request) != RM_GRANTED) {
+            reply(d, c, "DENIED\n");
+            return;
+        }
+
+        d->jobs[pid] = c;
+        c->pid = pid;
+        reply(d, c, "OK %d\n", pid);
+
+    } else if (strcmp(line, "RQ") == 0) {
+
+        if (c->pid == -1 || parse_values(d, operand, c->request) == -1) {
+            reply(d, c, "DENIED\n");
+            return;
+        }
+
+        c->waiting = true;
+        c->told_wait = false;
+        d->batch[d->batch_count++] = c;
+        d->requests_count++;
+
+    } else if (strcmp(line, "RL") == 0) {
+
+        if (c->pid == -1 || parse_values(d, operand, c->request) == -1 ||
+            rm_release(d->rm, c->pid, c->request) != RM_GRANTED) {
+            reply(d, c, "DENIED\n");
+            return;
+        }
+
+        d->released = true;
+        reply(d, c, "OK\n");
+
+    } else if (strcmp(line, "END") == 0) {
+
+        if (c->pid == -1) {
+            reply(d, c, "DENIED\n");
+            return;
+        }
+
+        end_job(d, c);
+        reply(d, c, "OK\n");
+
+    } else {
+
+        reply(d, c, "ERROR unknown message\n");
+    }
+}
+
+/* Function to answer the complete lines read from a client, stopping at
+ * a request until it is granted */
+static void handle_input(Daemon *d, Client *c) {
+
+    char *line = c->in;
+    char *newline;
+    size_t consumed;
+
+    while (!c->waiting &&
+           (newline = memchr(line, '\n', c->in + c->in_used - line)) != NULL) {
+
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r') {
+            newline[-1] = '\0';
+        }
+
+        handle_message(d, c, line);
+        line = newline + 1;
+    }
+
+    consumed = line - c->in;
+    memmove(c->in, line, c->in_used - consumed);
+    c->in_used -= consumed;
+}
+
+/* Function to read what a client sent. Returns -1 if the connection
+ * failed or sent a line that is too long */
+static int read_client(Daemon *d, Client *c) {
+
+    ssize_t count;
+
+    /* a full buffer left behind a request that was granted since holds
+     * a line that is too long */
+    if (!c->waiting && c->in_used == DAEMON_LINE_MAX) {
+        return -1;
+    }
+
+    while (c->in_used < DAEMON_LINE_MAX) {
+
+        count = read(c->fd, c->in + c->in_used, DAEMON_LINE_MAX - c->in_used);
+
+        if (count == 0) {
+
+            /* the job may still read the replies of a half closed
+             * connection */
+            c->hangup = true;
+            mark_dirty(d, c);
+            return 0;
+        }
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        c->in_used += count;
+        handle_input(d, c);
+
+        if (!c->waiting && c->in_used == DAEMON_LINE_MAX) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Function to close the connection of a client, ending its job. The
+ * client is freed by flush_clients() once the pass is over */
+static void drop_client(Daemon *d, Client *c) {
+
+    if (c->waiting) {
+        remove_request(d->batch, &d->batch_count, c);
+        remove_request(d->waiters, &d->waiters_count, c);
+        c->waiting = false;
+    }
+
+    if (c->pid != -1) {
+        end_job(d, c);
+    }
+
+    epoll_ctl(d->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->closed = true;
+    mark_dirty(d, c);
+}
+
+/* Function to accept the pending connections */
+static void accept_clients(Daemon *d, int listen_fd) {
+
+    int fd;
+    Client *c;
+    struct epoll_event event;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) != -1) {
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        c = allocate_zeroed(1, sizeof(Client));
+        c->fd = fd;
+        c->pid = -1;
+        c->request = allocate_zeroed(d->num_resources, sizeof(int));
+        c->events = EPOLLIN;
+
+        event.events = EPOLLIN;
+        event.data.ptr = c;
+        if (epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            close(fd);
+            free(c->request);
+            free(c);
+            continue;
+        }
+
+        TAILQ_INSERT_TAIL(&d->clients, c, clients);
+        d->connections++;
+    }
+}
+
+/* Function to decide the requests read in the pass, with the waiters
+ * first in the order they came when something was released. A granted
+ * job carries on with the messages pipelined behind its request, which
+ * may add requests to the next batch */
+static void decide_requests(Daemon *d) {
+
+    int i;
+    int count;
+    Client *c;
+
+    while (d->batch_count > 0 || (d->released && d->waiters_count > 0)) {
+
+        count = 0;
+
+        /* only a release can turn a denied request into a grant */
+        if (d->released) {
+            memcpy(d->deciding, d->waiters, d->waiters_count * sizeof(Client *));
+            count = d->waiters_count;
+            d->waiters_count = 0;
+            d->released = false;
+        }
+
+        memcpy(d->deciding + count, d->batch, d->batch_count * sizeof(Client *));
+        count += d->batch_count;
+        d->batch_count = 0;
+
+        for (i = 0; i < count; i++) {
+            d->pids[i] = d->deciding[i]->pid;
+            d->requests[i] = d->deciding[i]->request;
+        }
+
+        rm_request_batch(d->rm, count, d->pids, d->requests, d->statuses);
+        d->batches++;
+        d->decided += count;
+
+        for (i = 0; i < count; i++) {
+
+            c = d->deciding[i];
+
+            if (d->statuses[i] == RM_GRANTED) {
+                reply(d, c, "GRANTED\n");
+                c->waiting = false;
+            } else if (d->statuses[i] == RM_INVALID) {
+                reply(d, c, "DENIED\n");
+                c->waiting = false;
+            } else {
+                if (!c->told_wait) {
+                    reply(d, c, "WAIT\n");
+                    c->told_wait = true;
+                    d->waits++;
+                }
+                d->waiters[d->waiters_count++] = c;
+            }
+        }
+
+        for (i = 0; i < count; i++) {
+
+            c = d->deciding[i];
+            if (c->waiting) {
+                continue;
+            }
+
+            /* drop the job if what it pipelined is a line too long */
+            handle_input(d, c);
+            if (!c->waiting && c->in_used == DAEMON_LINE_MAX) {
+                drop_client(d, c);
+            }
+        }
+    }
+}
+
+/* Function to write out the replies of the pass. Clients whose
+ * connection failed, or that hung up with nothing left to answer, are
+ * dropped, and the dropped clients are freed */
+static void flush_clients(Daemon *d) {
+
+    int i;
+    ssize_t count;
+    Client *c;
+
+    for (i = 0; i < d->dirty_count; i++) {
+
+        c = d->dirty[i];
+
+        while (!c->closed && c->out_used > 0) {
+
+            count = send(c->fd, c->out, c->out_used, MSG_NOSIGNAL);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop_client(d, c);
+                }
+                break;
+            }
+
+            memmove(c->out, c->out + count, c->out_used - count);
+            c->out_used -= count;
+        }
+
+        if (!c->closed && c->hangup && !c->waiting && c->out_used == 0) {
+            drop_client(d, c);
+        }
+
+        c->dirty = false;
+
+        if (c->closed) {
+            TAILQ_REMOVE(&d->clients, c, clients);
+            free(c->request);
+            free(c->out);
+            free(c);
+        } else {
+            update_events(d, c);
+        }
+    }
+
+    d->dirty_count = 0;
+}
+
+/* Function to create the listening socket at path, replacing the socket
+ * of a previous run. Returns -1 if it cannot be created */
+static int open_socket(const char *path) {
+
+    int fd;
+    struct stat info;
+    struct sockaddr_un address;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Socket path is too long: %s\n", path);
+        return -1;
+    }
+
+    if (stat(path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path);
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 ||
+        bind(fd, (struct sockaddr *) &address, sizeof(address)) == -1 ||
+        listen(fd, SOMAXCONN) == -1) {
+        perror(path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/* Function to serve the resources until SIGINT or SIGTERM */
+int run_daemon(const char *path, int num_resources, const int *total,
+               int capacity) {
+
+    int i;
+    int count;
+    int listen_fd;
+    Daemon daemon;
+    Daemon *d = &daemon;
+    Client *c;
+    RmStats stats;
+    sigset_t blocked;
+    sigset_t unblocked;
+    struct sigaction action;
+    struct epoll_event event;
+    struct epoll_event events[DAEMON_EVENTS];
+
+    memset(d, 0, sizeof(Daemon));
+    d->num_resources = num_resources;
+    d->capacity = capacity;
+    TAILQ_INIT(&d->clients);
+
+    d->rm = rm_create(num_resources, total, capacity);
+    if (d->rm == NULL) {
+        printf("Could not create the resource manager\n");
+        return -1;
+    }
+
+    /* each registered job has at most one request being decided */
+    d->jobs = allocate_zeroed(capacity, sizeof(Client *));
+    d->batch = allocate_zeroed(capacity, sizeof(Client *));
+    d->waiters = allocate_zeroed(capacity, sizeof(Client *));
+    d->deciding = allocate_zeroed(capacity, sizeof(Client *));
+    d->pids = allocate_zeroed(capacity, sizeof(int));
+    d->requests = allocate_zeroed(capacity, sizeof(int *));
+    d->statuses = allocate_zeroed(capacity, sizeof(RmStatus));
+
+    listen_fd = open_socket(path);
+    d->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (listen_fd == -1 || d->epoll_fd == -1 ||
+        epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == -1) {
+        if (listen_fd != -1) {
+            perror("epoll");
+            close(listen_fd);
+            unlink(path);
+        }
+        if (d->epoll_fd != -1) {
+            close(d->epoll_fd);
+        }
+        rm_destroy(d->rm);
+        return -1;
+    }
+
+    /* the signals are only taken while the loop waits for events */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigprocmask(SIG_BLOCK, &blocked, &unblocked);
+    sigdelset(&unblocked, SIGINT);
+    sigdelset(&unblocked, SIGTERM);
+
+    printf("Serving %d resources to up to %d jobs on %s\n", num_resources,
+           capacity, path);
+    fflush(stdout);
+
+    while (!stop_daemon) {
+
+        count = epoll_pwait(d->epoll_fd, events, DAEMON_EVENTS, -1,
+                            &unblocked);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll");
+            break;
+        }
+
+        for (i = 0; i < count; i++) {
+
+            c = events[i].data.ptr;
+
+            if (c == NULL) {
+                accept_clients(d, listen_fd);
+                continue;
+            }
+
+            if (c->closed) {
+                continue;
+            }
+
+            if ((events[i].events & EPOLLIN) && read_client(d, c) == -1) {
+                drop_client(d, c);
+                continue;
+            }
+
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                drop_client(d, c);
+            } else if (events[i].events & EPOLLOUT) {
+                mark_dirty(d, c);
+            }
+        }
+
+        /* dropping a client releases what its job held */
+        do {
+            decide_requests(d);
+            flush_clients(d);
+        } while (d->released && d->waiters_count > 0);
+    }
+
+    /* print info */
+    rm_stats(d->rm, &stats);
+    printf("\nConnections: %ld, messages: %ld\n", d->connections,
+           d->messages);
+    printf("Requests: %ld, waited: %ld, decided in %ld batches of %.1f\n",
+           d->requests_count, d->waits, d->batches,
+           d->batches > 0 ? (double) d->decided / d->batches : 0.0);
+    printf("Requests granted: %ld, unavailable: %ld, unsafe: %ld\n",
+           stats.fast_grants + stats.slow_grants, stats.unavailable,
+           stats.unsafe);
+
+    while ((c = TAILQ_FIRST(&d->clients)) != NULL) {
+        TAILQ_REMOVE(&d->clients, c, clients);
+        close(c->fd);
+        free(c->request);
+        free(c->out);
+        free(c);
+    }
+
+    sigprocmask(SIG_UNBLOCK, &blocked, NULL);
+    close(d->epoll_fd);
+    close(listen_fd);
+    unlink(path);
+
+    free(d->jobs);
+    free(d->batch);
+    free(d->waiters);
+    free(d->deciding);
+    free(d->pids);
+    free(d->requests);
+    free(d->statuses);
+    free(d->dirty);
+    rm_destroy(d->rm);
+    return 0;
+}
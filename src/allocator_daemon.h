@@ -0,0 +1,24 @@
+/**
+ * Daemon serving the Banker's algorithm to real jobs over a Unix domain
+ * socket. Each connection is one job, which registers its max need and
+ * then requests and releases resources, one message per line
+ *
+ *   REGISTER n1 n2 ...   OK pid, or DENIED
+ *   RQ n1 n2 ...         GRANTED, or WAIT and GRANTED once granted
+ *   RL n1 n2 ...         OK, or DENIED
+ *   END                  OK, releasing everything the job holds
+ *
+ * Messages may be pipelined. The requests read in one pass of the event
+ * loop are decided together by rm_request_batch()
+ **/
+
+#ifndef ALLOCATOR_DAEMON_H
+#define ALLOCATOR_DAEMON_H
+
+/* Function to serve num_resources resources with the given totals on a
+ * Unix domain socket at path, to up to capacity registered jobs at once,
+ * until SIGINT or SIGTERM. Returns -1 if the socket cannot be set up */
+int run_daemon(const char *path, int num_resources, const int *total,
+               int capacity);
+
+#endif
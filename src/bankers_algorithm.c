@@ -10,749 +10,4825 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
 #include <sys/queue.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <ctype.h>
-
-/* Constants for the resources to be managed */
+#include <time.h>
+#include "vector_kernels.h"
+#include "resource_manager.h"
+#include "pool_manager.h"
+#include "event_trace.h"
+#include "scheduler_stats.h"
+#include "allocator_daemon.h"
+#include "decision_stream.h"
+
+/* Default resources to be managed, used when neither the input header
+ * nor the command line give the resources */
 #define R1 13
 #define R2 10
 #define R3 7
 #define R4 12
 
+/* Default number of processes held in the ready set at once */
+#define READY_SET_SIZE 5
+
+/* Matrix storage is aligned to a cache line and every row is padded to
+ * a multiple of ROW_ALIGNMENT ints. Padding is kept at zero */
+#define MATRIX_ALIGNMENT 64
+#define ROW_ALIGNMENT 8
+
+/* Size of the blocks of the arena that parsed jobs are stored in */
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+/* Largest number of resources with safety checks specialized for it */
+#define SPECIALIZED_RESOURCES 8
+
+/* Minimum size of each read when the input cannot be mapped */
+#define INPUT_CHUNK_SIZE (1 << 20)
+
+/* Binary workload format. Values are stored in host byte order, which
+ * the byte_order field is checked against when loading */
+#define WORKLOAD_MAGIC "BNKW"
+#define WORKLOAD_VERSION 2
+#define WORKLOAD_BYTE_ORDER 0x01020304
+
+/* Checkpoint format. Values are stored in host byte order, and every
+ * section is padded to a multiple of 8 bytes */
+#define CHECKPOINT_MAGIC "BNKC"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_BYTE_ORDER 0x01020304
+
+/* Default number of ticks between checkpoints */
+#define CHECKPOINT_INTERVAL 100000
+
+/* Defaults of the workload generator. Generated resources without
+ * --resources have GENERATED_TOTAL units each */
+#define GENERATED_PROCESSES 1000
+#define GENERATED_LENGTH 10
+#define GENERATED_TOTAL 16
+#define GENERATED_SLEEP 9
+
 /* structs */
+
+/* An instruction is a fixed width record of num_resources values, so
+ * instructions are stored back to back and indexed with INSTRUCTION_AT */
 typedef struct Instruction {
     char id[4];
-    int values[4];
+    int values[];
 } Instruction;
 
-typedef struct Process {
+/* A job as read from the input. Jobs are shared read only by every run
+ * of the simulation. A job without a deadline has INT_MAX */
+typedef struct Job {
     int id;
-    int max_need[4];
-    int allocated_resources[4];
+    int priority;
+    int deadline;
     int instruction_counter;
+    int *max_need;
+    Instruction *instructions;
+} Job;
+
+/* A job admitted to the ready set. Processes are pooled by matrix slot,
+ * so the process of a terminated job is reused by the next one admitted */
+typedef struct Process {
+    int id;
+    int job;
+    int slot;
+    int *max_need;
+    int *allocated_resources;
     int current_instruction;
-    Instruction instructions[50];
+    int priority;
+    int wait_dimension;
+    long wait_sequence;
+    long wake_time;
+    long sleep_sequence;
+    long wait_start;
+    long wait_time;
+    long hold_start;
+    long hold_time;
+    long finish_time;
+    long lease_expiry;
+    long lease_sequence;
+    int lease_index;
+    bool preempted;
+    bool reclaimed;
+    int deadline;
+    int ready_index;
+    long ready_sequence;
+    Instruction *instructions;
     TAILQ_ENTRY(Process) processes;
     TAILQ_ENTRY(Process) hold_processes;
+    TAILQ_ENTRY(Process) safe_processes;
 } Process;
 
+/* Simulated times of a job, kept with --clock for print_times(). A job
+ * whose resources were taken back ended without finishing */
+typedef struct JobTimes {
+    long finish_time;
+    long wait_time;
+    long hold_time;
+    bool reclaimed;
+} JobTimes;
+
+/* Block of the arena. Allocations are bumped from data and a block is
+ * never freed while the jobs are in use */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+/* A contiguous row major matrix of rows x columns ints, with each row
+ * starting stride ints after the previous one */
+typedef struct Matrix {
+    int rows;
+    int columns;
+    int stride;
+    int *data;
+} Matrix;
+
+/* Tentative grant of resources to a process, kept in the undo log until
+ * it is committed or rolled back */
+typedef struct UndoEntry {
+    Process *process;
+    const int *resources;
+} UndoEntry;
+
+/* Input being parsed, mapped or read whole into memory. Positions are
+ * tracked to report the line and column of errors */
+typedef struct Input {
+    char *data;
+    size_t size;
+    size_t position;
+    size_t line_start;
+    int line;
+    bool mapped;
+} Input;
+
+/* Header of a binary workload. It is followed by the total resources,
+ * the process table, the max need of every process and the instruction
+ * records, each at the offset given here */
+typedef struct WorkloadHeader {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t num_resources;
+    uint32_t procs_count;
+    uint32_t instructs_count;
+    uint32_t instruction_size;
+    uint32_t reserved;
+    uint64_t resources_offset;
+    uint64_t processes_offset;
+    uint64_t max_need_offset;
+    uint64_t instructions_offset;
+} WorkloadHeader;
+
+/* Entry of the process table in a binary workload */
+typedef struct WorkloadProcess {
+    int32_t id;
+    int32_t first_instruction;
+    int32_t instruction_counter;
+    int32_t priority;
+    int32_t deadline;
+} WorkloadProcess;
+
+/* Header of a checkpoint. It is followed by the total and available
+ * resources, a record for every matrix slot, the ready, wait, hold and
+ * safe queues, the queue of every resource, the heap of sleepers and the
+ * free slots as lists of slots, and with --clock the times of every job */
+typedef struct CheckpointHeader {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t num_resources;
+    uint32_t ready_set_size;
+    uint32_t procs_count;
+    uint32_t instructs_count;
+    uint32_t record_size;
+    int32_t wake_policy;
+    int32_t timed_sleep;
+    int32_t next_job;
+    int32_t finished_count;
+    int32_t held_count;
+    int32_t safe_sequence_valid;
+    int32_t scheduler;
+    int64_t clock_time;
+    int64_t wait_sequence;
+    int64_t sleep_sequence;
+    int64_t requests_count;
+    int64_t unsafe_count;
+    int64_t unavailable_count;
+} CheckpointHeader;
+
+/* Record of a matrix slot in a checkpoint, with the allocation of its
+ * process padded to a multiple of 8 bytes. job is -1 for a free slot */
+typedef struct CheckpointProcess {
+    int32_t job;
+    int32_t current_instruction;
+    int32_t priority;
+    int32_t wait_dimension;
+    int64_t wait_sequence;
+    int64_t wake_time;
+    int64_t sleep_sequence;
+    int64_t wait_start;
+    int64_t wait_time;
+    int64_t hold_start;
+    int64_t hold_time;
+    int64_t finish_time;
+    int32_t allocation[];
+} CheckpointProcess;
+
+/* Entry of the step log kept between checkpoints, one for every
+ * instruction run */
+typedef struct CheckpointStep {
+    int64_t tick;
+    int32_t slot;
+    int32_t instruction;
+} CheckpointStep;
+
+/* Order in which waiting processes are woken. WAKE_ALL moves every
+ * waiter back to the ready queue on a release, the others wake only the
+ * waiters whose request is available, oldest or highest priority first */
+typedef enum WakePolicy {
+    WAKE_ALL,
+    WAKE_FIFO,
+    WAKE_PRIORITY
+} WakePolicy;
+
+/* State shared by the worker threads of run_threads() */
+typedef struct Workers {
+    PoolManager *pm;
+    atomic_int next_process;
+    atomic_int completed;
+    atomic_int terminated;
+    atomic_int stalled;
+} Workers;
+
+/* Settings of the workload generator */
+typedef struct Generator {
+    int processes;
+    int resources;
+    int length;
+    double contention;
+    int mix[3];
+    int priorities;
+    int deadlines;
+    uint64_t seed;
+} Generator;
+
+/* Queue of processes, linked through one of their TAILQ entries */
+TAILQ_HEAD(process_queue, Process);
+
+/* State of one run of the simulation. The parsed jobs are shared read
+ * only between runs, which admit them in order with the resources and
+ * ready set size they were started with */
+typedef struct Simulation {
+    int ready_set_size;
+    int *total_resources;
+    int next_job;
+    int finished_count;
+    JobTimes *times;
+    Matrix max_need_matrix;
+    Matrix allocation_matrix;
+    Matrix need_matrix;
+    int *available_matrix;
+    int held_count;
+    bool safe_sequence_valid;
+    bool quiet;
+    long wait_sequence;
+    long clock_time;
+    long sleep_sequence;
+    long requests_count;
+    long unsafe_count;
+    long unavailable_count;
+    long *safety_latencies;
+    int latencies_count;
+    int latencies_capacity;
+
+    /* min-heap of the sleeping processes ordered by wake time */
+    Process **sleepers;
+    int sleepers_count;
+
+    /* min-heap of the leases of the processes holding resources ordered
+     * by expiry, each process knowing its index, the processes that may
+     * be preempted and the counts of the resources taken back */
+    Process **leases;
+    int leases_count;
+    long lease_sequence;
+    Process **victims;
+    long expired_count;
+    long preempted_count;
+
+    /* min-heap of the ready processes in the order of the scheduler,
+     * kept unless it is FIFO, each process knowing its index */
+    Process **ready_heap;
+    int ready_count;
+    long ready_sequence;
+
+    /* jobs on standby that --admission picks from in input order, and
+     * how many times each was passed over */
+    int *standby;
+    int *standby_skips;
+    int standby_count;
+
+    /* scratch space for the safety checks, which read the need and
+     * allocation rows in place */
+    int *work;
+    uint64_t *unfinished;
+    int *safe_rows;
+
+    /* Matrix slots of the held processes. A process keeps its slot from
+     * admission to termination, and the rows of a free slot are zero.
+     * processes holds the process of every slot and held_slots has a bit
+     * set for every slot in use */
+    Process *processes;
+    Process **slot_processes;
+    uint64_t *held_slots;
+    int *free_slots;
+    int free_slots_count;
+
+    /* scratch space for terminate_process() and wake_waiters() */
+    int *released;
+    Process **woken_rows;
+
+    /* grants made tentatively until a safety check decides them */
+    UndoEntry *undo_log;
+    int undo_count;
+
+    struct process_queue ready_queue;
+    struct process_queue wait_queue;
+    struct process_queue hold_queue;
+    struct process_queue safe_queue;
+
+    /* Processes waiting for resources they are short on, one queue for
+     * each resource. wait_queue holds the processes denied as unsafe */
+    struct process_queue *wait_lists;
+} Simulation;
+
+/* A scheduler picks the ready process to run next. runs_before orders
+ * the ready processes, and NULL runs them in ready queue order */
+typedef struct Scheduler {
+    const char *name;
+    bool (*runs_before)(Process *p, Process *q);
+} Scheduler;
+
+/* Scenario of a sweep and the results of running it */
+typedef struct Scenario {
+    int *total_resources;
+    int ready_set_size;
+    int finished;
+    long ticks;
+    long requests;
+    long unsafe;
+    long unavailable;
+    long run_ns;
+} Scenario;
+
+/* Macros to address matrix rows and instruction records */
+#define MATRIX_ROW(m, i) ((m).data + (size_t) (i) * (m).stride)
+
+/* Macros for bitsets of matrix slots, 64 slots to a word */
+#define BITSET_WORDS(n) (((n) + 63) / 64)
+#define BITSET_SET(set, i) ((set)[(i) / 64] |= 1ULL << ((i) % 64))
+#define BITSET_CLEAR(set, i) ((set)[(i) / 64] &= ~(1ULL << ((i) % 64)))
+#define INSTRUCTION_AT(base, i) \
+    ((Instruction *) ((char *) (base) + (size_t) (i) * instruction_size))
+
+/* Macro to list the slots of a queue linked through field */
+#define QUEUE_SLOTS(queue, field, slots, count)       \
+    do {                                              \
+        Process *q_;                                  \
+        (count) = 0;                                  \
+        TAILQ_FOREACH(q_, (queue), field) {           \
+            (slots)[(count)++] = q_->slot;            \
+        }                                             \
+    } while (0)
+
+
+/* Macro to check if the leases of the processes are kept, for --lease
+ * or for --preempt, which preempts by expiring leases */
+#define LEASES_KEPT() (lease_ticks > 0 || preempt_policy != NULL)
+
 
 /* Function prototypes */
-int build_standby_queue();
-int build_max_need_matrix();
-int build_allocation_matrix();
-int build_need_matrix();
-int sleep_process(Process* p);
-int request_resources(Process* p, int* resources);
-int release_resources(Process* p, int* resources);
-int terminate_process(Process* p);
-Process create_process(char* data);
-bool is_safe_state();
-void run_processes();
-void execute_instruction(Process* p, Instruction *inst);
-void print_matrices();
+int parse_arguments(int argc, char **argv);
+int parse_resources(const char *text, int **resources);
+int parse_pools(const char *text, int *pool_of);
+int load_input(Input *in, int fd);
+int parse_error(Input *in, const char *message);
+int read_id(Input *in, char *id);
+int read_number(Input *in, int *number);
+int read_values(Input *in, int *values, int count);
+int set_resources(Input *in, bool header);
+int parse_workload(Input *in);
+int load_workload(Input *in);
+int write_workload(const char *path);
+int generate_workload(char *settings);
+int next_random(Generator *g, int bound);
+int read_jobs(const char *path);
+int sleep_process(Simulation *s, Process* p, int duration);
+int request_resources(Simulation *s, Process* p, int* resources);
+void deny_request(Simulation *s, Process *p, int *resources, TraceType type);
+int release_resources(Simulation *s, Process* p, int* resources);
+int terminate_process(Simulation *s, Process* p);
+int admit_process(Simulation *s);
+int short_dimension(Simulation *s, int *resources);
+int compare_waiters(const void *a, const void *b);
+bool sleeps_before(Process *p, Process *q);
+void make_ready(Simulation *s, Process *p);
+void leave_ready(Simulation *s, Process *p);
+void place_ready(Simulation *s, int i);
+void update_ready(Simulation *s, Process *p);
+bool runs_by_priority(Process *p, Process *q);
+bool runs_by_need(Process *p, Process *q);
+bool runs_by_deadline(Process *p, Process *q);
+long need_units(Process *p);
+int choose_standby(Simulation *s);
+bool holds_resources(Process *p);
+bool is_safe_state(Simulation *s, int *sequence);
+bool is_safe_request(Simulation *s, Process *p, int *resources);
+bool is_safe_reference(Simulation *s, int *sequence);
+bool is_safe_prefix(Simulation *s, Process *p, const int *resources);
+void select_safety_checks();
+void adopt_safe_sequence(Simulation *s, int *sequence);
+void admit_to_safe_sequence(Simulation *s, Process *p);
+void allocate_matrices(Simulation *s);
+void allocate_matrix(Matrix *m, int rows, int columns);
+void *arena_extend(void *start, size_t used, size_t size);
+void record_grant(Simulation *s, Process *p);
+void allocate_resources(Simulation *s, Process *p, const int *resources);
+void deallocate_resources(Simulation *s, Process *p, const int *resources);
+void tentative_grant(Simulation *s, Process *p, const int *resources);
+void commit_grants(Simulation *s);
+void abort_grants(Simulation *s);
+void wait_process(Simulation *s, Process *p, int *resources);
+void wake_waiters(Simulation *s, const int *released);
+void push_sleeper(Simulation *s, Process *p);
+Process *pop_sleeper(Simulation *s);
+void remove_sleeper(Simulation *s, int i);
+void wake_sleepers(Simulation *s);
+bool expires_before(Process *p, Process *q);
+void place_lease(Simulation *s, int i);
+void renew_lease(Simulation *s, Process *p);
+void drop_lease(Simulation *s, Process *p);
+void expire_leases(Simulation *s);
+void reclaim_process(Simulation *s, Process *p);
+void preempt_for(Simulation *s, Process *p);
+int victims_by_priority(Simulation *s, Process *p, Process **victims);
+int compare_victims(const void *a, const void *b);
+long held_units(Process *p);
+void print_times(Simulation *s);
+void sample_queues(Simulation *s);
+void print_benchmark(Simulation *s);
+void record_latency(Simulation *s, long start);
+int compare_latencies(const void *a, const void *b);
+long now_ns();
+void unload_input(Input *in);
+void skip_whitespace(Input *in, bool lines);
+bool at_line_end(Input *in);
+bool is_binary_workload(Input *in);
+bool workload_section_fits(Input *in, uint64_t offset, uint64_t count,
+                           uint64_t size);
+void run_processes(Simulation *s);
+Process *next_process(Simulation *s);
+int write_checkpoint(Simulation *s, const char *path);
+int restore_checkpoint(Simulation *s, const char *path);
+int rebuild_state(Simulation *s, Input *in, CheckpointHeader *header);
+int replay_steps(Simulation *s, const char *path);
+int start_checkpoints(Simulation *s);
+void take_checkpoint(Simulation *s);
+int finish_checkpoints();
+void log_step(Simulation *s, Process *p);
+void write_slots(FILE *file, const int *slots, int count);
+int32_t *take_list(Input *in, int *count);
+int *read_slots(Input *in, Simulation *s, int *count, bool held);
+void *take_bytes(Input *in, size_t size);
+int run_differential();
+long run_engine();
+void run_threads(int threads);
+void run_job(int slot, Job *job, PmFuture *future);
+void *run_worker(void *arg);
+void execute_instruction(Simulation *s, Process* p, Instruction *inst);
+void print_matrices(Simulation *s);
+void print_matrix(Simulation *s, Matrix *m);
+void start_simulation(Simulation *s, int *resources, int size);
+void free_simulation(Simulation *s);
+int read_scenarios(const char *path);
+void run_sweep(int threads);
+void *run_sweep_worker(void *arg);
+void run_scenario(Scenario *scenario);
+void *allocate(size_t size);
+void *grow(void *data, int *capacity, int count, size_t size);
+void *grow_bytes(void *data, size_t *capacity, size_t count);
 
 /* Global variables */
-int max_need_matrix[5][4];
-int allocation_matrix[5][4];
-int need_matrix[5][4];
-int available_matrix[4];
-Process temp;
-Process procs[128];
-Instruction instruct[256];
+int num_resources = 0;
+int ready_set_size = READY_SET_SIZE;
+int *total_resources = NULL;
+Job *procs = NULL;
+char *instruct = NULL;
+int *max_need_values = NULL;
 int procs_count = 0;
+int procs_capacity = 0;
 int instructs_count = 0;
-
-/* Heads for TAILQs */
-struct HEADNAME *standby_head;
-struct HEADNAME *ready_head;
-struct HEADNAME *wait_head;
-struct HEADNAME *hold_head;
-TAILQ_HEAD(standby_head, Process) standby_queue;
-TAILQ_HEAD(ready_head, Process) ready_queue;
-TAILQ_HEAD(wait_head, Process) wait_queue;
-TAILQ_HEAD(hold_head, Process) hold_queue;
+int instruction_size = 0;
+ArenaBlock *arena = NULL;
+const char *kernel_name = NULL;
+const char *convert_path = NULL;
+int thread_count = 0;
+Workers workers;
+WakePolicy wake_policy = WAKE_FIFO;
+bool timed_sleep = false;
+char *generate_settings = NULL;
+bool benchmark = false;
+const char *trace_path = NULL;
+bool stats_report = false;
+const char *stats_path = NULL;
+const char *decode_path = NULL;
+bool decode_events = false;
+bool generic_checks = false;
+const char *sweep_path = NULL;
+const char *daemon_path = NULL;
+const char *checkpoint_path = NULL;
+const char *restore_path = NULL;
+long checkpoint_interval = CHECKPOINT_INTERVAL;
+const char *record_path = NULL;
+const char *replay_path = NULL;
+bool differential = false;
+const char *pools_spec = NULL;
+long lease_ticks = 0;
+int admission_window = 0;
+long input_bytes = 0;
+long parse_ns = 0;
+long run_ns = 0;
+
+/* Safety checks set by select_safety_checks(), specialized for the
+ * number of resources when there are few */
+bool (*safe_state_check)(Simulation *s, int *sequence) = is_safe_state;
+bool (*safe_prefix_check)(Simulation *s, Process *p,
+                          const int *resources) = is_safe_prefix;
+
+/* true while --differential runs the reference engine, which decides
+ * every request with is_safe_reference() */
+bool reference_checks = false;
+
+/* Preemption policy set by --preempt. It lists the processes holding
+ * resources that the process p denied a request may preempt, in the
+ * order they are preempted, and returns how many there are */
+int (*preempt_policy)(Simulation *s, Process *p,
+                      Process **victims) = NULL;
+
+/* Schedulers selected by --scheduler, FIFO by default */
+Scheduler schedulers[] = {
+    {"fifo", NULL},
+    {"priority", runs_by_priority},
+    {"srn", runs_by_need},
+    {"edf", runs_by_deadline}
+};
+Scheduler *scheduler = &schedulers[0];
+
+/* Scenarios of a sweep, taken in order by the threads of run_sweep() */
+Scenario *scenarios = NULL;
+int scenarios_count = 0;
+int scenarios_capacity = 0;
+atomic_int next_scenario;
+
+/* Step log of the simulation, the segment it is written to and the
+ * process writing the last checkpoint, -1 once it is done */
+FILE *checkpoint_log = NULL;
+int checkpoint_segment = 0;
+long next_checkpoint = 0;
+pid_t checkpoint_writer = -1;
 
 /* Main */
 int main(int argc, char **argv) {
 
-    /* variables for loops */
-    int i, j, k, l;
+    int status;
+    long start;
+    Simulation sim;
+
+    /* read the resources and ready set size from the command line */
+    if (parse_arguments(argc, argv) == -1) {
+        return 1;
+    }
+
+    /* select the kernels used to compare and combine resource rows */
+    if (select_vector_kernels(kernel_name) == NULL) {
+        printf("Unsupported kernels: %s\n", kernel_name);
+        return 1;
+    }
+
+    /* decode a trace instead of running a workload */
+    if (decode_path != NULL) {
+        return trace_decode(decode_path, decode_events) == -1 ? 1 : 0;
+    }
+
+    /* write a synthetic workload instead of reading one */
+    if (generate_settings != NULL) {
+        return generate_workload(generate_settings) == -1 ? 1 : 0;
+    }
+
+    /* serve the resources on a socket instead of running a workload */
+    if (daemon_path != NULL) {
+        set_resources(NULL, false);
+        return run_daemon(daemon_path, num_resources, total_resources,
+                          ready_set_size) == -1 ? 1 : 0;
+    }
+
+    /* read the jobs from the input file or standard input */
+    start = now_ns();
+    if (read_jobs(optind < argc ? argv[optind] : NULL) == -1) {
+        return 1;
+    }
+    parse_ns = now_ns() - start;
+
+    /* write the workload in the binary format instead of running it */
+    if (convert_path != NULL) {
+        return write_workload(convert_path) == -1 ? 1 : 0;
+    }
+
+    /* pick the safety checks for the number of resources */
+    select_safety_checks();
+
+    /* checkpoints and decisions are only kept of a simulation run on
+     * its own */
+    if ((checkpoint_path != NULL || restore_path != NULL ||
+         record_path != NULL || replay_path != NULL || differential) &&
+        (sweep_path != NULL || thread_count > 0)) {
+        printf("--checkpoint, --restore, --record, --replay and "
+               "--differential cannot be combined with --sweep or "
+               "--threads\n");
+        return 1;
+    }
+
+    if (record_path != NULL && replay_path != NULL) {
+        printf("--record and --replay cannot be combined\n");
+        return 1;
+    }
+
+    /* leases are only kept by the simulation and are not checkpointed */
+    if (LEASES_KEPT() &&
+        ((thread_count > 0 && sweep_path == NULL) ||
+         checkpoint_path != NULL || restore_path != NULL)) {
+        printf("--lease and --preempt cannot be combined with --threads, "
+               "--checkpoint or --restore\n");
+        return 1;
+    }
+
+    /* the standby window is not checkpointed either */
+    if ((scheduler->runs_before != NULL || admission_window > 0) &&
+        thread_count > 0 && sweep_path == NULL) {
+        printf("--scheduler and --admission cannot be combined with "
+               "--threads\n");
+        return 1;
+    }
+
+    if (admission_window > 0 &&
+        (checkpoint_path != NULL || restore_path != NULL)) {
+        printf("--admission cannot be combined with --checkpoint or "
+               "--restore\n");
+        return 1;
+    }
+
+    /* the trace is only written by the simulation run on its own */
+    if (trace_path != NULL && (thread_count > 0 || differential) &&
+        sweep_path == NULL) {
+        printf("--trace cannot be combined with --threads or "
+               "--differential\n");
+        return 1;
+    }
+
+    /* and so are the scheduler counters */
+    if (stats_report && (thread_count > 0 || differential) &&
+        sweep_path == NULL) {
+        printf("--stats and --stats-dump cannot be combined with --threads "
+               "or --differential\n");
+        return 1;
+    }
+
+    /* check the engine selected against the reference engine */
+    if (differential) {
+        return run_differential() == -1 ? 1 : 0;
+    }
+
+    /* run the scenarios of a sweep in parallel, --threads sizes the pool */
+    if (sweep_path != NULL) {
+
+        if (trace_path != NULL || stats_report) {
+            printf("--sweep cannot be combined with --trace or --stats\n");
+            return 1;
+        }
+        if (read_scenarios(sweep_path) == -1) {
+            return 1;
+        }
+
+        run_sweep(thread_count);
+        return 0;
+    }
+
+    if (pools_spec != NULL && thread_count == 0) {
+        printf("--pools requires --threads\n");
+        return 1;
+    }
+
+    /* run the processes on worker threads instead of the simulation */
+    if (thread_count > 0) {
+        run_threads(thread_count);
+        return 0;
+    }
+
+    /* size the matrices now that the dimensions are known */
+    start_simulation(&sim, total_resources, ready_set_size);
+
+    /* record the events in place of the matrix dumps */
+    if (trace_path != NULL &&
+        trace_open(trace_path, num_resources, total_resources,
+                   ready_set_size) == -1) {
+        return 1;
+    }
+
+    /* count the scheduler hot paths */
+    if (stats_report && stats_open(stats_path) == -1) {
+        return 1;
+    }
+
+    /* the matrices are not printed with the report or the trace */
+    sim.quiet = benchmark || trace_enabled;
+
+    /* resume from a checkpoint, or build the ready queue, which fills
+     * the matrix slots */
+    if (restore_path != NULL) {
+        if (restore_checkpoint(&sim, restore_path) == -1) {
+            return 1;
+        }
+    } else {
+        while (sim.held_count < sim.ready_set_size && admit_process(&sim) == 0);
+    }
+
+    /* checkpoint the state periodically */
+    if (checkpoint_path != NULL && start_checkpoints(&sim) == -1) {
+        return 1;
+    }
+
+    /* record the decisions, or check them against a recorded run */
+    if ((record_path != NULL && decisions_record(record_path) == -1) ||
+        (replay_path != NULL && decisions_replay(replay_path) == -1)) {
+        return 1;
+    }
+
+    /* run the processes */
+    start = now_ns();
+    run_processes(&sim);
+    run_ns = now_ns() - start;
+
+    if (finish_checkpoints() == -1) {
+        return 1;
+    }
+
+    status = decisions_close();
+    decisions_free();
+    if (status == -1) {
+        return 1;
+    }
+
+    /* report the simulated times of the processes */
+    if (timed_sleep) {
+        print_times(&sim);
+    }
+
+    /* report the resources taken back */
+    if (LEASES_KEPT()) {
+        printf("Leases expired: %ld, jobs preempted: %ld\n",
+               sim.expired_count, sim.preempted_count);
+    }
+
+    if (benchmark) {
+        print_benchmark(&sim);
+    }
+
+    free_simulation(&sim);
+
+    if (trace_close() == -1) {
+        perror(trace_path);
+        return 1;
+    }
+
+    if (stats_close() == -1) {
+        perror(stats_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Function to read the command line options. The resources are given
+ * as a comma separated list, the ready set size as a count and the
+ * kernels as avx2, sse4 or scalar. --convert names the file to write
+ * the workload to in the binary format, --threads runs the processes
+ * on that many threads and --wake sets the order waiters are woken in.
+ * --clock makes SL sleep for its operand in simulated time.
+ * --generate writes a synthetic workload and --benchmark replaces the
+ * output with a report of how fast the workload ran. --trace records
+ * the events to a file in place of the matrix dumps, which --decode
+ * rebuilds and --decode-events lists. --stats reports the scheduler
+ * counters at the end and --stats-dump also writes them every
+ * --stats-interval ticks. --sweep runs the scenarios listed in a file
+ * in parallel and --generic turns off the safety checks specialized for
+ * a small number of resources. --daemon serves the resources to jobs
+ * connecting to a Unix domain socket. --checkpoint saves the state of
+ * the simulation every --checkpoint-interval ticks, which --restore
+ * resumes from. --record writes the decisions of a run to a file and
+ * --replay checks a run against them, and --differential checks the
+ * engine selected against the generic safety checks and scalar kernels.
+ * --pools splits the resources of --threads into independent pools.
+ * --lease takes the resources back from a job that holds them for that
+ * many ticks after its last grant, and --preempt lets a denied job take
+ * them from jobs of lower priority. --scheduler picks the order ready
+ * jobs run in and --admission admits the job most likely to be granted
+ * safely out of that many on standby */
+int parse_arguments(int argc, char **argv) {
+
+    int i;
+    int option;
+
+    static struct option options[] = {
+        {"resources", required_argument, NULL, 'r'},
+        {"ready-set", required_argument, NULL, 'n'},
+        {"kernels", required_argument, NULL, 'k'},
+        {"convert", required_argument, NULL, 'c'},
+        {"threads", required_argument, NULL, 't'},
+        {"wake", required_argument, NULL, 'w'},
+        {"clock", no_argument, NULL, 'l'},
+        {"generate", optional_argument, NULL, 'g'},
+        {"benchmark", no_argument, NULL, 'B'},
+        {"trace", required_argument, NULL, 'T'},
+        {"decode", required_argument, NULL, 'd'},
+        {"decode-events", required_argument, NULL, 'D'},
+        {"stats", no_argument, NULL, 's'},
+        {"stats-dump", required_argument, NULL, 'S'},
+        {"stats-interval", required_argument, NULL, 'i'},
+        {"sweep", required_argument, NULL, 'p'},
+        {"generic", no_argument, NULL, 'G'},
+        {"daemon", required_argument, NULL, 'u'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-interval", required_argument, NULL, 'I'},
+        {"restore", required_argument, NULL, 'R'},
+        {"record", required_argument, NULL, 'e'},
+        {"replay", required_argument, NULL, 'y'},
+        {"differential", no_argument, NULL, 'x'},
+        {"pools", required_argument, NULL, 'P'},
+        {"lease", required_argument, NULL, 'L'},
+        {"preempt", no_argument, NULL, 'E'},
+        {"scheduler", required_argument, NULL, 'o'},
+        {"admission", required_argument, NULL, 'a'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ((option = getopt_long(argc, argv, "r:n:k:c:t:w:lg::BT:d:D:sS:i:p:Gu:C:I:R:e:y:xP:L:Eo:a:",
+                                 options, NULL)) != -1) {
+
+        switch (option) {
+
+            case 'r':
+                num_resources = parse_resources(optarg, &total_resources);
+                if (num_resources <= 0) {
+                    printf("Invalid resources: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'n':
+                ready_set_size = atoi(optarg);
+                if (ready_set_size <= 0) {
+                    printf("Invalid ready set size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'k':
+                kernel_name = optarg;
+                break;
+
+            case 'c':
+                convert_path = optarg;
+                break;
+
+            case 't':
+                thread_count = atoi(optarg);
+                if (thread_count <= 0) {
+                    printf("Invalid thread count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'w':
+                if (strcmp(optarg, "all") == 0) {
+                    wake_policy = WAKE_ALL;
+                } else if (strcmp(optarg, "fifo") == 0) {
+                    wake_policy = WAKE_FIFO;
+                } else if (strcmp(optarg, "priority") == 0) {
+                    wake_policy = WAKE_PRIORITY;
+                } else {
+                    printf("Invalid wake policy: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'l':
+                timed_sleep = true;
+                break;
+
+            case 'g':
+                generate_settings = optarg != NULL ? optarg : "";
+                break;
+
+            case 'B':
+                benchmark = true;
+                break;
+
+            case 'T':
+                trace_path = optarg;
+                break;
+
+            case 'D':
+                decode_events = true;
+                decode_path = optarg;
+                break;
+
+            case 'd':
+                decode_path = optarg;
+                break;
+
+            case 's':
+                stats_report = true;
+                break;
+
+            case 'S':
+                stats_report = true;
+                stats_path = optarg;
+                break;
+
+            case 'i':
+                stats_interval = atol(optarg);
+                if (stats_interval <= 0) {
+                    printf("Invalid stats interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'p':
+                sweep_path = optarg;
+                break;
+
+            case 'G':
+                generic_checks = true;
+                break;
+
+            case 'u':
+                daemon_path = optarg;
+                break;
+
+            case 'C':
+                checkpoint_path = optarg;
+                break;
+
+            case 'I':
+                checkpoint_interval = atol(optarg);
+                if (checkpoint_interval <= 0) {
+                    printf("Invalid checkpoint interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'R':
+                restore_path = optarg;
+                break;
+
+            case 'e':
+                record_path = optarg;
+                break;
+
+            case 'y':
+                replay_path = optarg;
+                break;
+
+            case 'x':
+                differential = true;
+                break;
+
+            case 'P':
+                pools_spec = optarg;
+                break;
+
+            case 'L':
+                lease_ticks = atol(optarg);
+                if (lease_ticks <= 0) {
+                    printf("Invalid lease: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'E':
+                preempt_policy = victims_by_priority;
+                break;
+
+            case 'o':
+                scheduler = NULL;
+                for (i = 0; i < (int) (sizeof(schedulers) /
+                                       sizeof(schedulers[0])); i++) {
+                    if (strcmp(optarg, schedulers[i].name) == 0) {
+                        scheduler = &schedulers[i];
+                    }
+                }
+                if (scheduler == NULL) {
+                    printf("Invalid scheduler: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'a':
+                admission_window = atoi(optarg);
+                if (admission_window <= 0) {
+                    printf("Invalid admission window: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            default:
+                printf("Usage: %s [-r R1,R2,...] [-n ready_set_size]"
+                       " [-k avx2|sse4|scalar] [-c output] [-t threads]"
+                       " [-w all|fifo|priority] [-l] [-g[settings]] [-B]"
+                       " [-T trace] [-d|-D trace] [-s] [-S dump] [-i ticks]"
+                       " [-p scenarios] [-G] [-u socket] [-C checkpoint]"
+                       " [-I ticks] [-R checkpoint] [-e decisions]"
+                       " [-y decisions] [-x] [-P pools] [-L ticks] [-E]"
+                       " [-o fifo|priority|srn|edf] [-a jobs]"
+                       " [input]\n",
+                       argv[0]);
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Function to read a comma separated list of resource counts. Returns
+ * the number read, or -1 if the list is malformed */
+int parse_resources(const char *text, int **resources) {
+
+    int count = 0;
+    int capacity = 0;
+    long value;
+    char *end;
+
+    while (true) {
+
+        if (!isdigit((unsigned char) *text)) {
+            return -1;
+        }
+
+        value = strtol(text, &end, 10);
+        if (value > INT_MAX) {
+            return -1;
+        }
+
+        *resources = grow(*resources, &capacity, count + 1, sizeof(int));
+        (*resources)[count] = (int) value;
+        count++;
+
+        if (*end == '\0') {
+            return count;
+        }
+        if (*end != ',') {
+            return -1;
+        }
+        text = end + 1;
+    }
+}
+
+/* Function to read the pools of the resources, groups of resource
+ * numbers separated by colons, the numbers of a group separated by
+ * commas. Resources are numbered from 0 in the order of the totals, and
+ * every resource has to be in exactly one pool. Stores the pool of each
+ * resource in pool_of and returns the number of pools, or -1 if the list
+ * is malformed */
+int parse_pools(const char *text, int *pool_of) {
+
+    int i;
+    int pools = 0;
+    long value;
+    char *end;
+
+    for (i = 0; i < num_resources; i++) {
+        pool_of[i] = -1;
+    }
+
+    while (true) {
+
+        if (!isdigit((unsigned char) *text)) {
+            return -1;
+        }
+
+        value = strtol(text, &end, 10);
+        if (value >= num_resources || pool_of[value] != -1) {
+            return -1;
+        }
+        pool_of[value] = pools;
+
+        if (*end == '\0') {
+            pools++;
+            break;
+        }
+        if (*end == ':') {
+            pools++;
+        } else if (*end != ',') {
+            return -1;
+        }
+        text = end + 1;
+    }
+
+    for (i = 0; i < num_resources; i++) {
+        if (pool_of[i] == -1) {
+            return -1;
+        }
+    }
+
+    return pools;
+}
+
+/* Function to start a run of the simulation over the parsed jobs with
+ * the given totals and ready set size. Every job is on standby until it
+ * is admitted, in input order */
+void start_simulation(Simulation *s, int *resources, int size) {
+
+    int i;
+
+    memset(s, 0, sizeof(Simulation));
+    s->total_resources = resources;
+    s->ready_set_size = size;
+    s->safe_sequence_valid = true;
+
+    /* initialize queues for storing processes */
+    TAILQ_INIT(&s->ready_queue);
+    TAILQ_INIT(&s->wait_queue);
+    TAILQ_INIT(&s->hold_queue);
+    TAILQ_INIT(&s->safe_queue);
+
+    allocate_matrices(s);
+
+    /* build the initial resource availability matrix */
+    for (i = 0; i < num_resources; i++) {
+        s->available_matrix[i] = resources[i];
+    }
+
+    /* the times of every job are only reported with the clock */
+    if (timed_sleep) {
+        s->times = allocate(procs_count * sizeof(JobTimes));
+    }
+}
+
+/* Function to free the matrices, processes and scratch space of a run */
+void free_simulation(Simulation *s) {
+
+    free(s->max_need_matrix.data);
+    free(s->allocation_matrix.data);
+    free(s->need_matrix.data);
+    free(s->available_matrix);
+    free(s->work);
+    free(s->unfinished);
+    free(s->held_slots);
+    free(s->safe_rows);
+    free(s->processes);
+    free(s->slot_processes);
+    free(s->free_slots);
+    free(s->released);
+    free(s->woken_rows);
+    free(s->undo_log);
+    free(s->sleepers);
+    free(s->leases);
+    free(s->victims);
+    free(s->ready_heap);
+    free(s->standby);
+    free(s->standby_skips);
+    free(s->wait_lists);
+    free(s->safety_latencies);
+    free(s->times);
+}
+
+/* Function to allocate the matrices once the number of resources and the
+ * ready set size are known */
+void allocate_matrices(Simulation *s) {
+
+    int i;
+
+    allocate_matrix(&s->max_need_matrix, s->ready_set_size, num_resources);
+    allocate_matrix(&s->allocation_matrix, s->ready_set_size, num_resources);
+    allocate_matrix(&s->need_matrix, s->ready_set_size, num_resources);
+
+    s->available_matrix = allocate(s->max_need_matrix.stride * sizeof(int));
+    s->work = allocate(s->max_need_matrix.stride * sizeof(int));
+    s->unfinished = allocate(BITSET_WORDS(s->ready_set_size) *
+                             sizeof(uint64_t));
+    s->held_slots = allocate(BITSET_WORDS(s->ready_set_size) *
+                             sizeof(uint64_t));
+    s->safe_rows = allocate(s->ready_set_size * sizeof(int));
+    s->processes = allocate(s->ready_set_size * sizeof(Process));
+    s->slot_processes = allocate(s->ready_set_size * sizeof(Process *));
+    s->free_slots = allocate(s->ready_set_size * sizeof(int));
+    s->released = allocate(s->max_need_matrix.stride * sizeof(int));
+    s->woken_rows = allocate(s->ready_set_size * sizeof(Process *));
+    s->undo_log = allocate(s->ready_set_size * sizeof(UndoEntry));
+    s->sleepers = allocate(s->ready_set_size * sizeof(Process *));
+    s->leases = allocate(s->ready_set_size * sizeof(Process *));
+    s->victims = allocate(s->ready_set_size * sizeof(Process *));
+    s->ready_heap = allocate(s->ready_set_size * sizeof(Process *));
+    if (admission_window > 0) {
+        s->standby = allocate(admission_window * sizeof(int));
+        s->standby_skips = allocate(admission_window * sizeof(int));
+    }
+
+    s->wait_lists = allocate(num_resources * sizeof(struct process_queue));
+    for (i = 0; i < num_resources; i++) {
+        TAILQ_INIT(&s->wait_lists[i]);
+    }
+
+    /* hand out the slots from the first one */
+    for (i = s->ready_set_size - 1; i >= 0; i--) {
+        s->free_slots[s->free_slots_count++] = i;
+    }
+}
+
+/* Function to allocate a zeroed matrix with padded rows */
+void allocate_matrix(Matrix *m, int rows, int columns) {
+
+    m->rows = rows;
+    m->columns = columns;
+    m->stride = (columns + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+    m->data = allocate((size_t) rows * m->stride * sizeof(int));
+}
+
+/* Function to allocate zeroed, cache aligned memory */
+void *allocate(size_t size) {
+
+    void *data;
+
+    /* round up to a multiple of the alignment */
+    size = (size + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    if (size == 0) {
+        size = MATRIX_ALIGNMENT;
+    }
+
+    data = aligned_alloc(MATRIX_ALIGNMENT, size);
+    if (data == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    memset(data, 0, size);
+    return data;
+}
+
+/* Function to grow an array so it holds at least count elements */
+void *grow(void *data, int *capacity, int count, size_t size) {
+
+    if (count <= *capacity) {
+        return data;
+    }
+
+    /* double the capacity to keep appends amortized constant */
+    while (*capacity < count) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+    }
+
+    data = realloc(data, (size_t) *capacity * size);
+    if (data == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    return data;
+}
+
+/* Function to grow a buffer of bytes to hold at least count bytes, like
+ * grow() but with a size_t capacity for buffers past 2 GiB */
+void *grow_bytes(void *data, size_t *capacity, size_t count) {
+
+    if (count <= *capacity) {
+        return data;
+    }
+
+    while (*capacity < count) {
+
+        /* stop doubling before the capacity overflows */
+        if (*capacity > SIZE_MAX / 2) {
+            *capacity = count;
+            break;
+        }
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+    }
+
+    data = realloc(data, *capacity);
+    if (data == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    return data;
+}
+
+/* Function to grow the last allocation of the arena, which starts at
+ * start and is used bytes long, by size bytes. A new allocation is made
+ * if start is NULL. The allocation moves to a new block, and only its
+ * own bytes are copied, when the current block is full. Returns where
+ * the allocation starts */
+void *arena_extend(void *start, size_t used, size_t size) {
+
+    size_t offset;
+    size_t block_size;
+    ArenaBlock *block;
+
+    /* allocations start on an 8 byte boundary */
+    offset = start != NULL ? (size_t) ((char *) start - arena->data) :
+             arena != NULL ? (arena->used + 7) & ~(size_t) 7 : 0;
+
+    if (arena == NULL || offset + used + size > arena->size) {
+
+        block_size = ARENA_BLOCK_SIZE;
+        while (block_size < 2 * (used + size)) {
+            block_size *= 2;
+        }
+
+        block = malloc(sizeof(ArenaBlock) + block_size);
+        if (block == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+
+        block->next = arena;
+        block->size = block_size;
+        if (start != NULL) {
+            memcpy(block->data, start, used);
+        }
+
+        arena = block;
+        offset = 0;
+    }
+
+    arena->used = offset + used + size;
+    return arena->data + offset;
+}
+
+/* Function to admit the next job on standby into the ready set, as the
+ * process of a free matrix slot. Returns -1 if there are no more jobs
+ * to load */
+int admit_process(Simulation *s) {
+
+    int slot;
+    int index;
+    Job *job;
+    Process *p;
+
+    /* take the next job in input order, or the best on standby */
+    if (admission_window > 0) {
+        index = choose_standby(s);
+    } else {
+        index = s->next_job < procs_count ? s->next_job++ : -1;
+    }
+
+    if (index == -1) {
+        return -1;
+    }
+
+    /* reuse the process of a free slot */
+    job = &procs[index];
+    slot = s->free_slots[--s->free_slots_count];
+    p = &s->processes[slot];
+    memset(p, 0, sizeof(Process));
+
+    p->id = job->id;
+    p->job = index;
+    p->slot = slot;
+    p->max_need = job->max_need;
+    p->instructions = job->instructions;
+    p->priority = job->priority;
+    p->deadline = job->deadline;
+    p->wait_sequence = -1;
+    p->hold_start = -1;
+    p->lease_index = -1;
+    p->ready_index = -1;
+
+    /* fill the rows of the slot, nothing is allocated yet */
+    s->slot_processes[p->slot] = p;
+    BITSET_SET(s->held_slots, p->slot);
+    p->allocated_resources = MATRIX_ROW(s->allocation_matrix, p->slot);
+    memcpy(MATRIX_ROW(s->max_need_matrix, p->slot), p->max_need,
+           num_resources * sizeof(int));
+    memcpy(MATRIX_ROW(s->need_matrix, p->slot), p->max_need,
+           num_resources * sizeof(int));
+
+    TAILQ_INSERT_TAIL(&s->hold_queue, p, hold_processes);
+    make_ready(s, p);
+    admit_to_safe_sequence(s, p);
+    TRACE_EVENT(TRACE_ADMIT, p->id, p->slot, s->clock_time, p->max_need);
+    s->held_count++;
+
+    return 0;
+}
+
+/* Function to terminate a process and release all resources allocated to it */
+int terminate_process(Simulation *s, Process* p) {
+
+    /* the process is done and stops holding resources */
+    p->finish_time = s->clock_time;
+    if (p->hold_start != -1) {
+        p->hold_time += s->clock_time - p->hold_start;
+        p->hold_start = -1;
+    }
+    drop_lease(s, p);
+
+    /* keep the times of the job, the process is reused. A reclaimed job
+     * did not finish */
+    if (!p->reclaimed) {
+        s->finished_count++;
+    }
+    if (s->times != NULL) {
+        s->times[p->job].finish_time = p->finish_time;
+        s->times[p->job].wait_time = p->wait_time;
+        s->times[p->job].hold_time = p->hold_time;
+        s->times[p->job].reclaimed = p->reclaimed;
+    }
+
+    /* release allocated resources */
+    memcpy(s->released, p->allocated_resources, num_resources * sizeof(int));
+    TRACE_EVENT(TRACE_TERMINATE, p->id, p->slot, s->clock_time, s->released);
+    DECISION_EVENT(TRACE_TERMINATE, p->id, s->clock_time);
+    vector_add(s->available_matrix, p->allocated_resources, num_resources);
+
+    /* clear and free the slot of the process */
+    memset(MATRIX_ROW(s->allocation_matrix, p->slot), 0,
+           s->allocation_matrix.stride * sizeof(int));
+    memset(MATRIX_ROW(s->max_need_matrix, p->slot), 0,
+           s->max_need_matrix.stride * sizeof(int));
+    memset(MATRIX_ROW(s->need_matrix, p->slot), 0,
+           s->need_matrix.stride * sizeof(int));
+    s->slot_processes[p->slot] = NULL;
+    BITSET_CLEAR(s->held_slots, p->slot);
+    s->free_slots[s->free_slots_count++] = p->slot;
+    p->allocated_resources = NULL;
+
+    /* remove from ready_queue */
+    leave_ready(s, p);
+    TAILQ_REMOVE(&s->hold_queue, p, hold_processes);
+    s->held_count--;
+
+    /* a finished process can be dropped from the safe sequence
+     * without affecting the processes after it */
+    if (s->safe_sequence_valid) {
+        TAILQ_REMOVE(&s->safe_queue, p, safe_processes);
+    }
+
+    /* add the next processes to the ready_queue if there are more to load */
+    while (s->held_count < s->ready_set_size && admit_process(s) == 0);
+
+    /* wake the waiters the released resources can satisfy */
+    if (wake_policy != WAKE_ALL) {
+        wake_waiters(s, s->released);
+    }
+
+    return 0;
+}
+
+/* Function to run processes from the ready_queue */
+void run_processes(Simulation *s) {
+
+    Process* p;
+
+    /* loop until ready_queue is empty */
+    while ((p = next_process(s)) != NULL) {
+
+        /* every instruction takes one tick of the clock */
+        s->clock_time++;
+        if (STATS_DUE(s->clock_time)) {
+            sample_queues(s);
+        }
+
+        if (checkpoint_log != NULL) {
+            log_step(s, p);
+        }
+
+        /* execute the next instruction */
+        execute_instruction(s, p, INSTRUCTION_AT(p->instructions,
+                                              p->current_instruction));
+
+        if (checkpoint_log != NULL && s->clock_time >= next_checkpoint) {
+            take_checkpoint(s);
+        }
+    }
+}
+
+/* Function to find the process to run next, the first entry in the
+ * ready queue or the first in the order of the scheduler. Returns NULL
+ * if no process is left to run */
+Process *next_process(Simulation *s) {
+
+    long next;
+
+    /* jump the clock to the next wake up or lease expiry if nothing
+     * else can run */
+    if (TAILQ_EMPTY(&s->ready_queue)) {
+
+        next = s->sleepers_count > 0 ? s->sleepers[0]->wake_time : LONG_MAX;
+        if (s->leases_count > 0 && s->leases[0]->lease_expiry < next) {
+            next = s->leases[0]->lease_expiry;
+        }
+        if (next != LONG_MAX && next > s->clock_time) {
+            s->clock_time = next;
+        }
+    }
+
+    /* move the processes done sleeping to the ready queue */
+    if (s->sleepers_count > 0) {
+        wake_sleepers(s);
+    }
+
+    /* take back the resources of the expired and preempted processes,
+     * which wakes the waiters they satisfy */
+    if (s->leases_count > 0) {
+        expire_leases(s);
+    }
+
+    if (scheduler->runs_before != NULL) {
+        return s->ready_count > 0 ? s->ready_heap[0] : NULL;
+    }
+
+    return TAILQ_FIRST(&s->ready_queue);
+}
+
+/* Function to write the state of the simulation to path. The checkpoint
+ * is written to a temporary file that replaces path once it is complete,
+ * so path always holds a whole checkpoint. Returns -1 on failure */
+int write_checkpoint(Simulation *s, const char *path) {
+
+    int i;
+    int count;
+    int status = 0;
+    size_t record_size;
+    char temp_path[PATH_MAX];
+    int *slots;
+    FILE *file;
+    Process *p;
+    CheckpointHeader header;
+    CheckpointProcess *record;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        perror(temp_path);
+        return -1;
+    }
+
+    record_size = (sizeof(CheckpointProcess) +
+                   num_resources * sizeof(int32_t) + 7) & ~(size_t) 7;
+    record = allocate(record_size);
+    slots = allocate(s->ready_set_size * sizeof(int));
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.version = CHECKPOINT_VERSION;
+    header.num_resources = num_resources;
+    header.ready_set_size = s->ready_set_size;
+    header.procs_count = procs_count;
+    header.instructs_count = instructs_count;
+    header.record_size = record_size;
+    header.wake_policy = wake_policy;
+    header.scheduler = scheduler - schedulers;
+    header.timed_sleep = timed_sleep;
+    header.next_job = s->next_job;
+    header.finished_count = s->finished_count;
+    header.held_count = s->held_count;
+    header.safe_sequence_valid = s->safe_sequence_valid;
+    header.clock_time = s->clock_time;
+    header.wait_sequence = s->wait_sequence;
+    header.sleep_sequence = s->sleep_sequence;
+    header.requests_count = s->requests_count;
+    header.unsafe_count = s->unsafe_count;
+    header.unavailable_count = s->unavailable_count;
+
+    fwrite(&header, sizeof(header), 1, file);
+    write_slots(file, s->total_resources, num_resources);
+    write_slots(file, s->available_matrix, num_resources);
+
+    /* the rows of the matrices follow from the job and the allocation */
+    for (i = 0; i < s->ready_set_size; i++) {
+
+        memset(record, 0, record_size);
+        p = s->slot_processes[i];
+        record->job = -1;
+
+        if (p != NULL) {
+            record->job = p->job;
+            record->current_instruction = p->current_instruction;
+            record->priority = p->priority;
+            record->wait_dimension = p->wait_dimension;
+            record->wait_sequence = p->wait_sequence;
+            record->wake_time = p->wake_time;
+            record->sleep_sequence = p->sleep_sequence;
+            record->wait_start = p->wait_start;
+            record->wait_time = p->wait_time;
+            record->hold_start = p->hold_start;
+            record->hold_time = p->hold_time;
+            record->finish_time = p->finish_time;
+            memcpy(record->allocation, p->allocated_resources,
+                   num_resources * sizeof(int32_t));
+        }
+
+        fwrite(record, record_size, 1, file);
+    }
+
+    QUEUE_SLOTS(&s->ready_queue, processes, slots, count);
+    write_slots(file, slots, count);
+    QUEUE_SLOTS(&s->wait_queue, processes, slots, count);
+    write_slots(file, slots, count);
+    QUEUE_SLOTS(&s->hold_queue, hold_processes, slots, count);
+    write_slots(file, slots, count);
+    QUEUE_SLOTS(&s->safe_queue, safe_processes, slots, count);
+    write_slots(file, slots, count);
+
+    for (i = 0; i < num_resources; i++) {
+        QUEUE_SLOTS(&s->wait_lists[i], processes, slots, count);
+        write_slots(file, slots, count);
+    }
+
+    /* the heap is kept in the order of its array */
+    for (i = 0; i < s->sleepers_count; i++) {
+        slots[i] = s->sleepers[i]->slot;
+    }
+    write_slots(file, slots, s->sleepers_count);
+    write_slots(file, s->free_slots, s->free_slots_count);
+
+    if (s->times != NULL) {
+        fwrite(s->times, sizeof(JobTimes), procs_count, file);
+    }
+
+    /* the checkpoint is only put in place once it is on disk */
+    if (ferror(file) || fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        status = -1;
+    }
+    if (fclose(file) != 0 || status == -1 || rename(temp_path, path) != 0) {
+        perror(path);
+        unlink(temp_path);
+        status = -1;
+    }
+
+    free(record);
+    free(slots);
+    return status;
+}
+
+/* Function to write a list of count ints preceded by its count, padded
+ * to a multiple of 8 bytes */
+void write_slots(FILE *file, const int *slots, int count) {
+
+    int32_t padding = 0;
+
+    fwrite(&count, sizeof(int32_t), 1, file);
+    fwrite(slots, sizeof(int32_t), count, file);
+    if (count % 2 == 0) {
+        fwrite(&padding, sizeof(int32_t), 1, file);
+    }
+}
+
+/* Function to take size bytes from the input. Returns NULL if fewer are
+ * left */
+void *take_bytes(Input *in, size_t size) {
+
+    void *data;
+
+    if (in->size - in->position < size) {
+        return NULL;
+    }
+
+    data = in->data + in->position;
+    in->position += size;
+    return data;
+}
+
+/* Function to take a list written by write_slots(). Returns NULL if it
+ * is truncated */
+int32_t *take_list(Input *in, int *count) {
+
+    int32_t *values = take_bytes(in, sizeof(int32_t));
+
+    if (values == NULL || *values < 0) {
+        return NULL;
+    }
+
+    *count = *values;
+    return take_bytes(in, (size_t) (*count + (*count % 2 == 0)) *
+                          sizeof(int32_t));
+}
+
+/* Function to take a list of slots written by write_slots(). The slots
+ * must be held by a process if held is true, and free otherwise.
+ * Returns NULL if the list is truncated or holds a slot it should not */
+int *read_slots(Input *in, Simulation *s, int *count, bool held) {
+
+    int i;
+    int32_t *slots;
+
+    slots = take_list(in, count);
+    if (slots == NULL || *count > s->ready_set_size) {
+        return NULL;
+    }
+
+    for (i = 0; i < *count; i++) {
+        if (slots[i] < 0 || slots[i] >= s->ready_set_size ||
+            (s->slot_processes[slots[i]] != NULL) != held) {
+            return NULL;
+        }
+    }
+
+    return slots;
+}
+
+/* Function to resume the simulation from the checkpoint at path, which
+ * is mapped and rebuilt into the simulation started for it, then to
+ * replay the step log written after it. The checkpoint has to be of the
+ * same workload and settings. Returns -1 if it cannot be used */
+int restore_checkpoint(Simulation *s, const char *path) {
+
+    int count;
+    int fd;
+    int status;
+    int32_t *totals;
+    Input in;
+    CheckpointHeader *header;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return -1;
+    }
+
+    if (load_input(&in, fd) == -1) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    header = take_bytes(&in, sizeof(CheckpointHeader));
+    if (header == NULL || memcmp(header->magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        header->byte_order != CHECKPOINT_BYTE_ORDER ||
+        header->version != CHECKPOINT_VERSION ||
+        header->record_size < sizeof(CheckpointProcess) +
+                              num_resources * sizeof(int32_t)) {
+        printf("%s is not a checkpoint\n", path);
+        unload_input(&in);
+        return -1;
+    }
+
+    totals = take_list(&in, &count);
+    if (header->num_resources != (uint32_t) num_resources ||
+        header->ready_set_size != (uint32_t) s->ready_set_size ||
+        header->procs_count != (uint32_t) procs_count ||
+        header->instructs_count != (uint32_t) instructs_count ||
+        header->wake_policy != (int32_t) wake_policy ||
+        header->scheduler != (int32_t) (scheduler - schedulers) ||
+        header->timed_sleep != timed_sleep || totals == NULL ||
+        count != num_resources ||
+        memcmp(totals, s->total_resources, num_resources * sizeof(int)) != 0) {
+        printf("%s is not a checkpoint of this workload and settings\n",
+               path);
+        unload_input(&in);
+        return -1;
+    }
+
+    status = rebuild_state(s, &in, header);
+    unload_input(&in);
+
+    if (status == -1) {
+        printf("%s is corrupt\n", path);
+        return -1;
+    }
+
+    return replay_steps(s, path);
+}
+
+/* Function to rebuild the state of the simulation from the rest of a
+ * checkpoint. Returns -1 if it is inconsistent */
+int rebuild_state(Simulation *s, Input *in, CheckpointHeader *header) {
+
+    int i, j;
+    int count;
+    int *slots;
+    int32_t *available;
+    char *records;
+    Job *job;
+    Process *p;
+    CheckpointProcess *record;
+    JobTimes *times;
+
+    available = take_list(in, &count);
+    records = take_bytes(in, (size_t) header->record_size *
+                             s->ready_set_size);
+    if (available == NULL || count != num_resources || records == NULL ||
+        header->next_job < 0 || header->next_job > procs_count ||
+        header->held_count < 0 || header->held_count > s->ready_set_size) {
+        return -1;
+    }
+
+    memcpy(s->available_matrix, available, num_resources * sizeof(int));
+    s->next_job = header->next_job;
+    s->finished_count = header->finished_count;
+    s->held_count = header->held_count;
+    s->safe_sequence_valid = header->safe_sequence_valid;
+    s->clock_time = header->clock_time;
+    s->wait_sequence = header->wait_sequence;
+    s->sleep_sequence = header->sleep_sequence;
+    s->requests_count = header->requests_count;
+    s->unsafe_count = header->unsafe_count;
+    s->unavailable_count = header->unavailable_count;
+
+    /* rebuild the process and the matrix rows of every held slot */
+    for (i = 0; i < s->ready_set_size; i++) {
+
+        record = (CheckpointProcess *) (records +
+                                        (size_t) i * header->record_size);
+        if (record->job == -1) {
+            continue;
+        }
+
+        if (record->job < 0 || record->job >= s->next_job ||
+            record->current_instruction < 0 ||
+            record->current_instruction >=
+                procs[record->job].instruction_counter) {
+            return -1;
+        }
+
+        job = &procs[record->job];
+        p = &s->processes[i];
+        memset(p, 0, sizeof(Process));
+
+        p->id = job->id;
+        p->job = record->job;
+        p->slot = i;
+        p->max_need = job->max_need;
+        p->instructions = job->instructions;
+        p->current_instruction = record->current_instruction;
+        p->priority = record->priority;
+        p->wait_dimension = record->wait_dimension;
+        p->wait_sequence = record->wait_sequence;
+        p->wake_time = record->wake_time;
+        p->sleep_sequence = record->sleep_sequence;
+        p->wait_start = record->wait_start;
+        p->wait_time = record->wait_time;
+        p->hold_start = record->hold_start;
+        p->hold_time = record->hold_time;
+        p->finish_time = record->finish_time;
+        p->deadline = job->deadline;
+        p->lease_index = -1;
+        p->ready_index = -1;
+
+        s->slot_processes[i] = p;
+        BITSET_SET(s->held_slots, i);
+        p->allocated_resources = MATRIX_ROW(s->allocation_matrix, i);
+        memcpy(p->allocated_resources, record->allocation,
+               num_resources * sizeof(int));
+        memcpy(MATRIX_ROW(s->max_need_matrix, i), p->max_need,
+               num_resources * sizeof(int));
+        for (j = 0; j < num_resources; j++) {
+            MATRIX_ROW(s->need_matrix, i)[j] = p->max_need[j] -
+                                               p->allocated_resources[j];
+        }
+    }
+
+    /* rebuild the queues in their order */
+    if ((slots = read_slots(in, s, &count, true)) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        make_ready(s, s->slot_processes[slots[i]]);
+    }
+
+    if ((slots = read_slots(in, s, &count, true)) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        TAILQ_INSERT_TAIL(&s->wait_queue, s->slot_processes[slots[i]],
+                          processes);
+    }
+
+    if ((slots = read_slots(in, s, &count, true)) == NULL ||
+        count != s->held_count) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        TAILQ_INSERT_TAIL(&s->hold_queue, s->slot_processes[slots[i]],
+                          hold_processes);
+    }
+
+    if ((slots = read_slots(in, s, &count, true)) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        TAILQ_INSERT_TAIL(&s->safe_queue, s->slot_processes[slots[i]],
+                          safe_processes);
+    }
+
+    for (j = 0; j < num_resources; j++) {
+
+        if ((slots = read_slots(in, s, &count, true)) == NULL) {
+            return -1;
+        }
+        for (i = 0; i < count; i++) {
+            TAILQ_INSERT_TAIL(&s->wait_lists[j], s->slot_processes[slots[i]],
+                              processes);
+        }
+    }
+
+    if ((slots = read_slots(in, s, &count, true)) == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        s->sleepers[i] = s->slot_processes[slots[i]];
+    }
+    s->sleepers_count = count;
+
+    if ((slots = read_slots(in, s, &count, false)) == NULL ||
+        count != s->ready_set_size - s->held_count) {
+        return -1;
+    }
+    memcpy(s->free_slots, slots, count * sizeof(int));
+    s->free_slots_count = count;
+
+    if (s->times != NULL) {
+        times = take_bytes(in, procs_count * sizeof(JobTimes));
+        if (times == NULL) {
+            return -1;
+        }
+        memcpy(s->times, times, procs_count * sizeof(JobTimes));
+    }
+
+    return 0;
+}
+
+/* Function to replay the steps logged after the checkpoint at path was
+ * taken, without printing anything. The two segments of the log are
+ * replayed from the oldest, and every step must run the instruction it
+ * ran before. A step cut short by a crash is left out. Returns -1 if
+ * the log does not match the checkpoint */
+int replay_steps(Simulation *s, const char *path) {
+
+    int i, k;
+    int fd;
+    int first;
+    int status = 0;
+    long count;
+    long replayed = 0;
+    bool quiet = s->quiet;
+    char log_path[PATH_MAX];
+    Input segments[2];
+    CheckpointStep *steps;
+    Process *p;
+
+    for (k = 0; k < 2; k++) {
+
+        segments[k].size = 0;
+        segments[k].mapped = false;
+        segments[k].data = NULL;
+
+        snprintf(log_path, sizeof(log_path), "%s.log.%d", path, k);
+        fd = open(log_path, O_RDONLY);
+        if (fd != -1) {
+            if (load_input(&segments[k], fd) == -1) {
+                segments[k].size = 0;
+            }
+            close(fd);
+        }
+    }
+
+    /* the segment starting at the earlier tick goes first */
+    first = segments[1].size >= sizeof(CheckpointStep) &&
+            (segments[0].size < sizeof(CheckpointStep) ||
+             ((CheckpointStep *) segments[1].data)->tick <
+             ((CheckpointStep *) segments[0].data)->tick);
+
+    s->quiet = true;
+
+    for (i = 0; i < 2 && status == 0; i++) {
+
+        k = i == 0 ? first : !first;
+        steps = (CheckpointStep *) segments[k].data;
+        count = segments[k].size / sizeof(CheckpointStep);
+
+        for (; count > 0; count--, steps++) {
+
+            if (steps->tick <= s->clock_time) {
+                continue;
+            }
+
+            p = next_process(s);
+            if (p == NULL || p->slot != steps->slot ||
+                p->current_instruction != steps->instruction ||
+                s->clock_time + 1 != steps->tick) {
+                printf("The log of %s does not match it at tick %ld\n", path,
+                       (long) steps->tick);
+                status = -1;
+                break;
+            }
+
+            s->clock_time++;
+            execute_instruction(s, p, INSTRUCTION_AT(p->instructions,
+                                                  p->current_instruction));
+            replayed++;
+        }
+    }
+
+    s->quiet = quiet;
+
+    for (k = 0; k < 2; k++) {
+        if (segments[k].data != NULL) {
+            unload_input(&segments[k]);
+        }
+    }
+
+    if (status == 0) {
+        printf("Restored %s at tick %ld, replayed %ld steps\n", path,
+               s->clock_time, replayed);
+    }
+
+    return status;
+}
+
+/* Function to write the first checkpoint, before anything runs, and
+ * start the step log. Returns -1 if either cannot be written */
+int start_checkpoints(Simulation *s) {
+
+    char log_path[PATH_MAX];
+
+    if (write_checkpoint(s, checkpoint_path) == -1) {
+        return -1;
+    }
+
+    /* the other segment is left over from an earlier run */
+    snprintf(log_path, sizeof(log_path), "%s.log.1", checkpoint_path);
+    unlink(log_path);
+
+    snprintf(log_path, sizeof(log_path), "%s.log.0", checkpoint_path);
+    checkpoint_log = fopen(log_path, "wb");
+    if (checkpoint_log == NULL) {
+        perror(log_path);
+        return -1;
+    }
+
+    checkpoint_segment = 0;
+    next_checkpoint = s->clock_time + checkpoint_interval;
+    return 0;
+}
+
+/* Function to take a checkpoint while the simulation keeps running. A
+ * forked child writes the copy on write image of the state, and the log
+ * moves to the other segment, whose steps the last checkpoint already
+ * covers. No checkpoint is taken while the last one is being written */
+void take_checkpoint(Simulation *s) {
+
+    int status;
+    pid_t pid;
+    char log_path[PATH_MAX];
+
+    next_checkpoint = s->clock_time + checkpoint_interval;
+
+    if (checkpoint_writer != -1) {
+
+        if (waitpid(checkpoint_writer, &status, WNOHANG) == 0) {
+            return;
+        }
+
+        /* the log stays whole from the last checkpoint written, so
+         * restoring still works without the new ones */
+        checkpoint_writer = -1;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("Could not write the checkpoint %s, checkpoints are "
+                   "stopped\n", checkpoint_path);
+            next_checkpoint = LONG_MAX;
+            return;
+        }
+    }
+
+    /* the steps up to the checkpoint must be in the current segment */
+    fflush(checkpoint_log);
+
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return;
+    }
+
+    /* the child leaves the buffered output of the parent alone */
+    if (pid == 0) {
+        _exit(write_checkpoint(s, checkpoint_path) == -1 ? 1 : 0);
+    }
+
+    checkpoint_writer = pid;
+
+    checkpoint_segment = !checkpoint_segment;
+    snprintf(log_path, sizeof(log_path), "%s.log.%d", checkpoint_path,
+             checkpoint_segment);
+
+    fclose(checkpoint_log);
+    checkpoint_log = fopen(log_path, "wb");
+    if (checkpoint_log == NULL) {
+        perror(log_path);
+        next_checkpoint = LONG_MAX;
+    }
+}
+
+/* Function to wait for the last checkpoint and close the step log.
+ * Returns -1 if the checkpoint or the log could not be written */
+int finish_checkpoints() {
+
+    int status = 0;
+    int writer_status;
+
+    if (checkpoint_writer != -1) {
+
+        waitpid(checkpoint_writer, &writer_status, 0);
+        checkpoint_writer = -1;
+        if (!WIFEXITED(writer_status) || WEXITSTATUS(writer_status) != 0) {
+            printf("Could not write the checkpoint %s\n", checkpoint_path);
+            status = -1;
+        }
+    }
+
+    if (checkpoint_log != NULL && fclose(checkpoint_log) != 0) {
+        perror(checkpoint_path);
+        status = -1;
+    }
+
+    checkpoint_log = NULL;
+    return status;
+}
+
+/* Function to append the instruction about to run to the step log */
+void log_step(Simulation *s, Process *p) {
+
+    CheckpointStep step;
+
+    step.tick = s->clock_time;
+    step.slot = p->slot;
+    step.instruction = p->current_instruction;
+    fwrite(&step, sizeof(step), 1, checkpoint_log);
+}
+
+/* Function to run the workload on the reference engine, which decides
+ * every request with a full safety check from scratch and the scalar
+ * kernels, recording its decisions, then on the engine selected, which
+ * has to make the same decisions with its cached safe sequence, bitset
+ * search and undo log. Returns -1 if a decision differs */
+int run_differential() {
+
+    int status;
+    long reference_ns;
+    long compared_ns;
+    const char *kernels;
+
+    /* run the reference engine */
+    select_vector_kernels("scalar");
+    safe_state_check = is_safe_reference;
+    reference_checks = true;
+    decisions_record(NULL);
+    reference_ns = run_engine();
+    decisions_close();
+    reference_checks = false;
+
+    /* run the engine selected against the decisions of the reference */
+    kernels = select_vector_kernels(kernel_name);
+    select_safety_checks();
+    decisions_replay(NULL);
+    compared_ns = run_engine();
+    status = decisions_close();
+    decisions_free();
+
+    printf("Reference: full checks, scalar kernels, %.3f ms\n",
+           reference_ns / 1e6);
+    printf("Compared:  %s checks, %s kernels, %.3f ms\n",
+           safe_state_check == is_safe_state ? "generic" : "specialized",
+           kernels, compared_ns / 1e6);
+
+    return status;
+}
+
+/* Function to run the whole workload without printing. Returns how long
+ * the processes ran in nanoseconds */
+long run_engine() {
+
+    long start;
+    Simulation sim;
+
+    start_simulation(&sim, total_resources, ready_set_size);
+    sim.quiet = true;
+
+    while (sim.held_count < sim.ready_set_size && admit_process(&sim) == 0);
+
+    start = now_ns();
+    run_processes(&sim);
+    start = now_ns() - start;
+
+    free_simulation(&sim);
+    return start;
+}
+
+/* Function to run the processes on worker threads sharing a thread safe
+ * resource manager, instead of the single threaded round robin. With
+ * --pools each pool of resources has a manager of its own */
+void run_threads(int threads) {
+
+    int i;
+    int pools = 1;
+    int *pool_of;
+    pthread_t *thread_ids;
+    PoolStats stats;
+
+    /* every resource is in one pool unless they are split */
+    pool_of = allocate(num_resources * sizeof(int));
+    memset(pool_of, 0, num_resources * sizeof(int));
+
+    if (pools_spec != NULL) {
+        pools = parse_pools(pools_spec, pool_of);
+        if (pools == -1) {
+            printf("Invalid pools: %s\n", pools_spec);
+            free(pool_of);
+            return;
+        }
+    }
+
+    workers.pm = pm_create(num_resources, total_resources, threads, pools,
+                           pool_of);
+    free(pool_of);
+    if (workers.pm == NULL) {
+        printf("Could not create the resource manager\n");
+        return;
+    }
+
+    thread_ids = allocate(threads * sizeof(pthread_t));
+
+    /* each thread uses its index as its process number in the manager */
+    for (i = 0; i < threads; i++) {
+        pthread_create(&thread_ids[i], NULL, run_worker, (void *) (intptr_t) i);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(thread_ids[i], NULL);
+    }
+
+    /* print info */
+    pm_stats(workers.pm, &stats);
+    printf("Threads: %d\n", threads);
+    printf("Jobs completed: %d, terminated: %d, stalled: %d\n",
+           atomic_load(&workers.completed), atomic_load(&workers.terminated),
+           atomic_load(&workers.stalled));
+    printf("Requests granted: %ld (%ld on the fast path), "
+           "unavailable: %ld, unsafe: %ld\n",
+           stats.decisions.fast_grants + stats.decisions.slow_grants,
+           stats.decisions.fast_grants, stats.decisions.unavailable,
+           stats.decisions.unsafe);
+    printf("Releases: %ld (%ld on the fast path)\n",
+           stats.decisions.fast_releases + stats.decisions.slow_releases,
+           stats.decisions.fast_releases);
+    printf("Requests completed by a release: %ld, pending requests "
+           "retried: %ld\n", stats.pending - stats.stalled, stats.retries);
+
+    if (pools > 1) {
+        printf("Pools: %d, jobs spanning pools: %ld, requests across pools "
+               "granted: %ld, denied: %ld\n", pools, stats.shared,
+               stats.cross_grants, stats.cross_denials);
+    }
+
+    free(thread_ids);
+    pm_destroy(workers.pm);
+}
+
+/* Function run by each worker thread. Takes processes in input order
+ * until there are none left */
+void *run_worker(void *arg) {
+
+    int slot = (int) (intptr_t) arg;
+    int index;
+    Job *job;
+    PmFuture future;
+
+    pm_future_init(&future);
+
+    while ((index = atomic_fetch_add(&workers.next_process, 1)) < procs_count) {
+
+        job = &procs[index];
+
+        /* a process that needs more than the totals can never run */
+        if (pm_register(workers.pm, slot, job->max_need) != RM_GRANTED) {
+            atomic_fetch_add(&workers.terminated, 1);
+            continue;
+        }
+
+        run_job(slot, job, &future);
+        pm_exit(workers.pm, slot);
+    }
+
+    pm_future_destroy(&future);
+    return NULL;
+}
+
+/* Function to execute the instructions of a job on a worker thread */
+void run_job(int slot, Job *job, PmFuture *future) {
+
+    int i;
+    RmStatus status;
+    Instruction *inst;
+
+    for (i = 0; i < job->instruction_counter; i++) {
+
+        inst = INSTRUCTION_AT(job->instructions, i);
+
+        /* determine the instruction and execute accordingly */
+        if (inst->id[0] == 'R' && inst->id[1] == 'Q') {
+
+            /* a denied request is completed by the release that lets it
+             * be granted, or left ungranted if no release can come */
+            pm_request_future(workers.pm, slot, inst->values, future);
+            status = pm_future_wait(future);
+
+            if (status == RM_INVALID) {
+                atomic_fetch_add(&workers.terminated, 1);
+                return;
+            }
+            if (status != RM_GRANTED) {
+                atomic_fetch_add(&workers.stalled, 1);
+                return;
+            }
+        }
+        else if (inst->id[0] == 'R' && inst->id[1] == 'L') {
+
+            /* abnormally terminate the process if it releases more
+             * resources than it has */
+            if (pm_release(workers.pm, slot, inst->values) != RM_GRANTED) {
+                atomic_fetch_add(&workers.terminated, 1);
+                return;
+            }
+        }
+        else if (inst->id[0] == 'S' && inst->id[1] == 'L') {
+
+            /* let the other threads run */
+            sched_yield();
+        }
+        else if (inst->id[0] == 'E' && inst->id[1] == 'N') {
+
+            atomic_fetch_add(&workers.completed, 1);
+            return;
+        }
+    }
+}
+
+/* Function to read the scenarios of a sweep from path. Each line gives
+ * the totals of the resources as a comma separated list, optionally
+ * followed by the ready set size, which defaults to --ready-set. Blank
+ * lines and lines starting with # are skipped */
+int read_scenarios(const char *path) {
+
+    int line = 0;
+    int count;
+    char text[1024];
+    char *resources;
+    char *size;
+    FILE *file;
+    Scenario *scenario;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(text, sizeof(text), file) != NULL) {
+
+        line++;
+        resources = strtok(text, " \t\r\n");
+        if (resources == NULL || resources[0] == '#') {
+            continue;
+        }
+        size = strtok(NULL, " \t\r\n");
+
+        scenarios = grow(scenarios, &scenarios_capacity, scenarios_count + 1,
+                         sizeof(Scenario));
+        scenario = &scenarios[scenarios_count];
+        memset(scenario, 0, sizeof(Scenario));
+
+        count = parse_resources(resources, &scenario->total_resources);
+        if (count != num_resources) {
+            printf("%s, line %d: expected %d resources\n", path, line,
+                   num_resources);
+            fclose(file);
+            return -1;
+        }
+
+        scenario->ready_set_size = size != NULL ? atoi(size) : ready_set_size;
+        if (scenario->ready_set_size <= 0 || strtok(NULL, " \t\r\n") != NULL) {
+            printf("%s, line %d: invalid ready set size\n", path, line);
+            fclose(file);
+            return -1;
+        }
+
+        scenarios_count++;
+    }
+
+    fclose(file);
+
+    if (scenarios_count == 0) {
+        printf("%s: no scenarios\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Function to run the scenarios of a sweep on a pool of threads, one
+ * per CPU unless threads is given. The threads share the parsed workload
+ * and each scenario runs in its own simulation. The results are printed
+ * as a table in scenario order */
+void run_sweep(int threads) {
+
+    int i, j;
+    long start;
+    pthread_t *thread_ids;
+    Scenario *sc;
+
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads <= 0 || threads > scenarios_count) {
+        threads = scenarios_count;
+    }
+
+    thread_ids = allocate(threads * sizeof(pthread_t));
+    atomic_init(&next_scenario, 0);
+
+    start = now_ns();
+    for (i = 0; i < threads; i++) {
+        pthread_create(&thread_ids[i], NULL, run_sweep_worker, NULL);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(thread_ids[i], NULL);
+    }
+    run_ns = now_ns() - start;
+
+    /* print the results */
+    printf("Scenario\tReady set\tFinished\tTicks\tRequests\tUnsafe\t"
+           "Unavailable\tTime (ms)\tResources\n");
+    for (i = 0; i < scenarios_count; i++) {
+
+        sc = &scenarios[i];
+        printf("%d\t\t%d\t\t%d\t\t%ld\t%ld\t\t%ld\t%ld\t\t%.3f\t\t", i + 1,
+               sc->ready_set_size, sc->finished, sc->ticks, sc->requests,
+               sc->unsafe, sc->unavailable, sc->run_ns / 1e6);
+        for (j = 0; j < num_resources; j++) {
+            printf(j == 0 ? "%d" : ",%d", sc->total_resources[j]);
+        }
+        printf("\n");
+    }
+
+    printf("Ran %d scenarios of %d jobs on %d threads in %.3f ms\n",
+           scenarios_count, procs_count, threads, run_ns / 1e6);
+
+    free(thread_ids);
+}
+
+/* Function run by each thread of a sweep. Takes scenarios in order
+ * until there are none left */
+void *run_sweep_worker(void *arg) {
+
+    int index;
+
+    (void) arg;
+
+    while ((index = atomic_fetch_add(&next_scenario, 1)) < scenarios_count) {
+        run_scenario(&scenarios[index]);
+    }
+
+    return NULL;
+}
+
+/* Function to run a scenario of a sweep */
+void run_scenario(Scenario *scenario) {
+
+    long start;
+    Simulation *s;
+
+    s = allocate(sizeof(Simulation));
+    start_simulation(s, scenario->total_resources, scenario->ready_set_size);
+    s->quiet = true;
+
+    start = now_ns();
+    while (s->held_count < s->ready_set_size && admit_process(s) == 0);
+    run_processes(s);
+    scenario->run_ns = now_ns() - start;
+
+    scenario->finished = s->finished_count;
+    scenario->ticks = s->clock_time;
+    scenario->requests = s->requests_count;
+    scenario->unsafe = s->unsafe_count;
+    scenario->unavailable = s->unavailable_count;
+
+    free_simulation(s);
+    free(s);
+}
+
+/* Function to execute an instruction */
+void execute_instruction(Simulation *s, Process* p, Instruction *inst) {
+
+    /* determine the instruction and execute accordingly */
+    if (inst->id[0] == 'R' && inst->id[1] == 'Q') {
+
+        /* if request is granted, increment current_instruction */
+        if(request_resources(s, p, inst->values) == 0) {
+            p->current_instruction += 1;
+            return;
+        }
+
+    }
+    else if (inst->id[0] == 'R' && inst->id[1] == 'L') {
+
+        /* release desired resources. A process terminated for
+         * releasing too much may already be reused */
+        if (release_resources(s, p, inst->values) == 0) {
+            p->current_instruction += 1;
+        }
+        return;
+    }
+    else if (inst->id[0] == 'S' && inst->id[1] == 'L') {
+
+        /* sleep the current process */
+        TRACE_EVENT(TRACE_SLEEP, p->id, p->slot, s->clock_time, inst->values);
+        sleep_process(s, p, inst->values[0]);
+        p->current_instruction += 1;
+        return;
+    }
+    else if (inst->id[0] == 'E' && inst->id[1] == 'N') {
+
+        /* terminate the current process */
+        terminate_process(s, p);
+        return;
+    }
+
+    return;
+}
+
+/* Function to map the input, or read it whole with large reads if it
+ * cannot be mapped (a pipe or terminal) */
+int load_input(Input *in, int fd) {
+
+    struct stat info;
+    ssize_t bytes_read;
+    size_t capacity = 0;
+
+    in->data = NULL;
+    in->size = 0;
+    in->position = 0;
+    in->line = 1;
+    in->line_start = 0;
+    in->mapped = false;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+
+        in->data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (in->data != MAP_FAILED) {
+            madvise(in->data, info.st_size, MADV_SEQUENTIAL);
+            in->size = info.st_size;
+            in->mapped = true;
+            return 0;
+        }
+        in->data = NULL;
+    }
+
+    /* read the whole input, doubling the buffer as it fills */
+    while (true) {
+
+        if (in->size > SIZE_MAX - INPUT_CHUNK_SIZE) {
+            printf("Input too large\n");
+            return -1;
+        }
+        in->data = grow_bytes(in->data, &capacity,
+                              in->size + INPUT_CHUNK_SIZE);
+
+        /* a single read is capped at SSIZE_MAX */
+        bytes_read = read(fd, in->data + in->size,
+                          capacity - in->size < SSIZE_MAX ?
+                          capacity - in->size : SSIZE_MAX);
+
+        if (bytes_read == 0) {
+            return 0;
+        }
+        if (bytes_read < 0) {
+            perror("read");
+            return -1;
+        }
+        in->size += bytes_read;
+    }
+}
+
+/* Function to release the input once it has been parsed */
+void unload_input(Input *in) {
+
+    if (in->mapped) {
+        munmap(in->data, in->size);
+    } else {
+        free(in->data);
+    }
+}
+
+/* Function to print a parse error at the current position */
+int parse_error(Input *in, const char *message) {
+
+    printf("line %d, column %zu: %s\n", in->line,
+           in->position - in->line_start + 1, message);
+    return -1;
+}
+
+/* Function to skip blanks, and newlines as well if lines is true */
+void skip_whitespace(Input *in, bool lines) {
+
+    char c;
+
+    while (in->position < in->size) {
+
+        c = in->data[in->position];
+
+        if (c == '\n' && lines) {
+            in->line++;
+            in->line_start = in->position + 1;
+        } else if (c != ' ' && c != '\t' && c != '\r' &&
+                   c != '\v' && c != '\f') {
+            return;
+        }
+
+        in->position++;
+    }
+}
+
+/* Function to check if the rest of the line is blank */
+bool at_line_end(Input *in) {
+
+    skip_whitespace(in, false);
+
+    return in->position == in->size || in->data[in->position] == '\n';
+}
+
+/* Function to read the instruction id starting the next line into id.
+ * id is left empty at the end of the input */
+int read_id(Input *in, char *id) {
+
+    int length = 0;
+
+    skip_whitespace(in, true);
+
+    while (in->position < in->size &&
+           isalpha((unsigned char) in->data[in->position])) {
+
+        if (length == 3) {
+            return parse_error(in, "instruction too long");
+        }
+        id[length] = in->data[in->position];
+        length++;
+        in->position++;
+    }
+
+    if (length == 0 && in->position < in->size) {
+        return parse_error(in, "expected an instruction");
+    }
+    id[length] = '\0';
+
+    return 0;
+}
+
+/* Function to read the number at the current position */
+int read_number(Input *in, int *number) {
+
+    long value = 0;
+
+    if (!isdigit((unsigned char) in->data[in->position])) {
+        return parse_error(in, "expected a number");
+    }
+
+    /* read input while it is a number */
+    while (in->position < in->size &&
+           isdigit((unsigned char) in->data[in->position])) {
+
+        value = value * 10 + (in->data[in->position] - '0');
+        if (value > INT_MAX) {
+            return parse_error(in, "number too large");
+        }
+        in->position++;
+    }
+
+    *number = (int) value;
+    return 0;
+}
+
+/* Function to read up to count numbers from the rest of the line into
+ * values, filling the values not given with 0 */
+int read_values(Input *in, int *values, int count) {
+
+    int i = 0;
+
+    while (!at_line_end(in)) {
+
+        if (i == count) {
+            return parse_error(in, "too many values");
+        }
+
+        if (read_number(in, &values[i]) == -1) {
+            return -1;
+        }
+        i++;
+    }
+
+    /* values not given are 0 */
+    for (; i < count; i++) {
+        values[i] = 0;
+    }
+
+    return 0;
+}
+
+/* Function to set the resources from the 'RS' header, the command line
+ * or the defaults, in that order of precedence */
+int set_resources(Input *in, bool header) {
+
+    int *header_resources = NULL;
+    int capacity = 0;
+    int count = 0;
+
+    if (header) {
+
+        /* read every value on the header line */
+        while (!at_line_end(in)) {
+
+            header_resources = grow(header_resources, &capacity, count + 1,
+                                    sizeof(int));
+            if (read_number(in, &header_resources[count]) == -1) {
+                return -1;
+            }
+            count++;
+        }
+
+        if (count == 0) {
+            return parse_error(in, "expected the resources");
+        }
+
+        /* resources from the command line take precedence */
+        if (num_resources == 0) {
+            num_resources = count;
+            total_resources = allocate(count * sizeof(int));
+            memcpy(total_resources, header_resources, count * sizeof(int));
+        } else if (num_resources != count) {
+            free(header_resources);
+            return parse_error(in, "header does not match --resources");
+        }
+
+        free(header_resources);
+    }
+
+    /* fall back to the default resources */
+    if (num_resources == 0) {
+        num_resources = 4;
+        total_resources = allocate(num_resources * sizeof(int));
+        total_resources[0] = R1;
+        total_resources[1] = R2;
+        total_resources[2] = R3;
+        total_resources[3] = R4;
+    }
+
+    instruction_size = sizeof(Instruction) + num_resources * sizeof(int);
+    return 0;
+}
+
+/* Function to parse the input in one pass, storing each job straight
+ * into procs and its max need and instructions into the arena, where the
+ * instructions of a job take exactly the space they need */
+int parse_workload(Input *in) {
+
+    char id[4];
+    Job *p;
+    Instruction *inst;
+
+    /* the header can only appear before the first process */
+    if (read_id(in, id) == -1) {
+        return -1;
+    }
+
+    if (strcmp(id, "RS") == 0) {
+
+        if (set_resources(in, true) == -1 || read_id(in, id) == -1) {
+            return -1;
+        }
+    } else if (set_resources(in, false) == -1) {
+        return -1;
+    }
+
+    if (id[0] == '\0') {
+        return parse_error(in, "no processes in input");
+    }
+
+    /* parse the file one process at a time */
+    while (id[0] != '\0') {
+
+        if (strcmp(id, "ID") != 0) {
+            in->position -= strlen(id);
+            return parse_error(in, "expected ID");
+        }
+
+        procs = grow(procs, &procs_capacity, procs_count + 1, sizeof(Job));
+        p = &procs[procs_count];
+        memset(p, 0, sizeof(Job));
+
+        /* read the ID number */
+        if (read_values(in, &p->id, 1) == -1) {
+            return -1;
+        }
+
+        /* read the optional priority and deadline, then the max need */
+        p->deadline = INT_MAX;
+        while (true) {
+
+            if (read_id(in, id) == -1) {
+                return -1;
+            }
+
+            if (strcmp(id, "PR") == 0) {
+                if (read_values(in, &p->priority, 1) == -1) {
+                    return -1;
+                }
+            } else if (strcmp(id, "DL") == 0) {
+                if (read_values(in, &p->deadline, 1) == -1) {
+                    return -1;
+                }
+            } else {
+                break;
+            }
+        }
+
+        if (strcmp(id, "MN") != 0) {
+            in->position -= strlen(id);
+            return parse_error(in, "expected MN");
+        }
+
+        p->max_need = arena_extend(NULL, 0, num_resources * sizeof(int));
+        if (read_values(in, p->max_need, num_resources) == -1) {
+            return -1;
+        }
+
+        /* loop until 'END', the final instruction */
+        do {
+
+            if (read_id(in, id) == -1) {
+                return -1;
+            }
+
+            if (strcmp(id, "RQ") != 0 && strcmp(id, "RL") != 0 &&
+                strcmp(id, "SL") != 0 && strcmp(id, "END") != 0) {
+                in->position -= strlen(id);
+                return parse_error(in, id[0] == '\0' ? "expected END" :
+                                   "unknown instruction");
+            }
+
+            /* append the instruction record to those of the job */
+            p->instructions = arena_extend(p->instructions,
+                                           (size_t) p->instruction_counter *
+                                           instruction_size,
+                                           instruction_size);
+            inst = INSTRUCTION_AT(p->instructions, p->instruction_counter);
+            memcpy(inst->id, id, sizeof(inst->id));
+
+            if (read_values(in, inst->values, num_resources) == -1) {
+                return -1;
+            }
+
+            instructs_count++;
+            p->instruction_counter++;
+
+        } while (strcmp(id, "END") != 0);
+
+        procs_count++;
+
+        /* read the ID of the next process */
+        if (read_id(in, id) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Function to check if the input is a binary workload */
+bool is_binary_workload(Input *in) {
+
+    return in->size >= sizeof(WorkloadHeader) &&
+           memcmp(in->data, WORKLOAD_MAGIC, 4) == 0;
+}
+
+/* Function to check that count records of size bytes at offset lie
+ * inside the input and are aligned for int access */
+bool workload_section_fits(Input *in, uint64_t offset, uint64_t count,
+                           uint64_t size) {
+
+    return offset % sizeof(int) == 0 && offset <= in->size &&
+           (size == 0 || count <= (in->size - offset) / size);
+}
+
+/* Function to load a binary workload. The max needs and instructions are
+ * used in place from the input, only the process table is copied into
+ * procs. The input must stay loaded while the jobs run */
+int load_workload(Input *in) {
+
+    int i;
+    WorkloadHeader *header = (WorkloadHeader *) in->data;
+    WorkloadProcess *table;
+    Instruction *last;
+
+    if (header->byte_order != WORKLOAD_BYTE_ORDER) {
+        printf("Binary workload has a different byte order\n");
+        return -1;
+    }
+    if (header->version != WORKLOAD_VERSION) {
+        printf("Unsupported binary workload version %u\n", header->version);
+        return -1;
+    }
+
+    if (header->num_resources == 0 || header->num_resources > INT_MAX / 4 ||
+        header->procs_count == 0 || header->procs_count > INT_MAX ||
+        header->instructs_count > INT_MAX ||
+        header->instruction_size != sizeof(Instruction) +
+                                    header->num_resources * sizeof(int) ||
+        !workload_section_fits(in, header->resources_offset,
+                               header->num_resources, sizeof(int)) ||
+        !workload_section_fits(in, header->processes_offset,
+                               header->procs_count, sizeof(WorkloadProcess)) ||
+        !workload_section_fits(in, header->max_need_offset,
+                               header->procs_count,
+                               header->num_resources * sizeof(int)) ||
+        !workload_section_fits(in, header->instructions_offset,
+                               header->instructs_count,
+                               header->instruction_size)) {
+        printf("Binary workload is truncated or corrupt\n");
+        return -1;
+    }
+
+    /* resources from the command line take precedence */
+    if (num_resources == 0) {
+        num_resources = header->num_resources;
+        total_resources = (int *) (in->data + header->resources_offset);
+    } else if (num_resources != (int) header->num_resources) {
+        printf("Binary workload has %u resources, expected %d\n",
+               header->num_resources, num_resources);
+        return -1;
+    }
+
+    instruction_size = header->instruction_size;
+    max_need_values = (int *) (in->data + header->max_need_offset);
+    instruct = in->data + header->instructions_offset;
+    instructs_count = header->instructs_count;
+
+    /* fill the processes from the process table */
+    table = (WorkloadProcess *) (in->data + header->processes_offset);
+    procs = allocate(header->procs_count * sizeof(Job));
+    procs_count = header->procs_count;
+
+    for (i = 0; i < procs_count; i++) {
+
+        /* every process has to end with an END inside the pool */
+        if (table[i].instruction_counter <= 0 ||
+            table[i].first_instruction < 0 ||
+            table[i].first_instruction >
+                instructs_count - table[i].instruction_counter) {
+            printf("Binary workload process %d is corrupt\n", i);
+            return -1;
+        }
+
+        last = INSTRUCTION_AT(instruct, table[i].first_instruction +
+                                        table[i].instruction_counter - 1);
+        if (memcmp(last->id, "END", 4) != 0) {
+            printf("Binary workload process %d does not end\n", i);
+            return -1;
+        }
+
+        procs[i].id = table[i].id;
+        procs[i].priority = table[i].priority;
+        procs[i].deadline = table[i].deadline;
+        procs[i].instruction_counter = table[i].instruction_counter;
+        procs[i].max_need = max_need_values + (size_t) i * num_resources;
+        procs[i].instructions = INSTRUCTION_AT(instruct,
+                                               table[i].first_instruction);
+    }
+
+    return 0;
+}
+
+/* Function to write the parsed workload to path in the binary format */
+int write_workload(const char *path) {
+
+    int i;
+    int first = 0;
+    FILE *file;
+    WorkloadHeader header;
+    WorkloadProcess process;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WORKLOAD_MAGIC, 4);
+    header.byte_order = WORKLOAD_BYTE_ORDER;
+    header.version = WORKLOAD_VERSION;
+    header.num_resources = num_resources;
+    header.procs_count = procs_count;
+    header.instructs_count = instructs_count;
+    header.instruction_size = instruction_size;
+
+    /* sections follow each other in this order */
+    header.resources_offset = sizeof(header);
+    header.processes_offset = header.resources_offset +
+                              num_resources * sizeof(int);
+    header.max_need_offset = header.processes_offset +
+                             procs_count * sizeof(WorkloadProcess);
+    header.instructions_offset = header.max_need_offset +
+                                 (uint64_t) procs_count * num_resources *
+                                 sizeof(int);
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(total_resources, sizeof(int), num_resources, file);
+
+    /* the instructions of the jobs are written back to back */
+    for (i = 0; i < procs_count; i++) {
+        process.id = procs[i].id;
+        process.first_instruction = first;
+        process.instruction_counter = procs[i].instruction_counter;
+        process.priority = procs[i].priority;
+        process.deadline = procs[i].deadline;
+        fwrite(&process, sizeof(process), 1, file);
+        first += procs[i].instruction_counter;
+    }
+
+    for (i = 0; i < procs_count; i++) {
+        fwrite(procs[i].max_need, sizeof(int), num_resources, file);
+    }
+
+    for (i = 0; i < procs_count; i++) {
+        fwrite(procs[i].instructions, instruction_size,
+               procs[i].instruction_counter, file);
+    }
+
+    if (ferror(file) | fclose(file)) {
+        perror(path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Function to write a synthetic workload to standard output. settings is
+ * a comma separated list of processes=N, resources=N, length=N (the most
+ * instructions before END), contention=F (the fraction of the totals a
+ * max need may reach), mix=RQ:RL:SL (the weights of the instructions),
+ * seed=N, priorities=N (priorities drawn from 0 to N - 1) and
+ * deadlines=N (deadlines drawn from tick 1 to N). The totals come from
+ * --resources if given. Every request stays within the max need and
+ * every release within the allocation */
+int generate_workload(char *settings) {
+
+    int i, j, k;
+    int length;
+    int kind;
+    int *max_need;
+    int *held;
+    int *values;
+    char *value;
+    Generator g = {GENERATED_PROCESSES, 0, GENERATED_LENGTH, 1.0,
+                   {4, 3, 3}, 0, 0, 1};
+
+    char *const names[] = {"processes", "resources", "length",
+                           "contention", "mix", "seed", "priorities",
+                           "deadlines", NULL};
+
+    while (*settings != '\0') {
+
+        switch (getsubopt(&settings, names, &value)) {
+
+            case 0:
+                g.processes = value != NULL ? atoi(value) : -1;
+                break;
+
+            case 1:
+                g.resources = value != NULL ? atoi(value) : -1;
+                break;
+
+            case 2:
+                g.length = value != NULL ? atoi(value) : -1;
+                break;
+
+            case 3:
+                g.contention = value != NULL ? atof(value) : -1;
+                break;
+
+            case 4:
+                if (value == NULL ||
+                    sscanf(value, "%d:%d:%d", &g.mix[0], &g.mix[1],
+                           &g.mix[2]) != 3) {
+                    g.mix[0] = -1;
+                }
+                break;
+
+            case 5:
+                g.seed = value != NULL ? strtoull(value, NULL, 10) : 0;
+                break;
+
+            case 6:
+                g.priorities = value != NULL ? atoi(value) : -1;
+                break;
+
+            case 7:
+                g.deadlines = value != NULL ? atoi(value) : -1;
+                break;
+
+            default:
+                printf("Unknown generator setting: %s\n", value);
+                return -1;
+        }
+    }
+
+    if (g.processes < 0 || g.resources < 0 || g.length <= 0 ||
+        g.contention < 0 || g.contention > 1 || g.mix[0] < 0 ||
+        g.mix[1] < 0 || g.mix[2] < 0 ||
+        g.mix[0] + g.mix[1] + g.mix[2] == 0 || g.priorities < 0 ||
+        g.deadlines < 0) {
+        printf("Invalid generator settings\n");
+        return -1;
+    }
+
+    /* the seed of the xorshift generator must not be zero */
+    g.seed = g.seed * 2685821657736338717ULL + 1;
+
+    /* resources from the command line take precedence */
+    if (num_resources == 0 && g.resources > 0) {
+        num_resources = g.resources;
+        total_resources = allocate(num_resources * sizeof(int));
+        for (j = 0; j < num_resources; j++) {
+            total_resources[j] = GENERATED_TOTAL;
+        }
+    } else if (num_resources == 0) {
+        set_resources(NULL, false);
+    } else if (g.resources > 0 && g.resources != num_resources) {
+        printf("Generator resources do not match --resources\n");
+        return -1;
+    }
+
+    max_need = allocate(num_resources * sizeof(int));
+    held = allocate(num_resources * sizeof(int));
+    values = allocate(num_resources * sizeof(int));
+
+    printf("RS");
+    for (j = 0; j < num_resources; j++) {
+        printf("\t%d", total_resources[j]);
+    }
+    printf("\n");
+
+    for (i = 1; i <= g.processes; i++) {
+
+        /* without priorities and deadlines the workload is the same as
+         * before they could be generated */
+        printf("ID\t%d\n", i);
+        if (g.priorities > 0) {
+            printf("PR\t%d\n", next_random(&g, g.priorities));
+        }
+        if (g.deadlines > 0) {
+            printf("DL\t%d\n", next_random(&g, g.deadlines) + 1);
+        }
+
+        printf("MN");
+        for (j = 0; j < num_resources; j++) {
+            max_need[j] = next_random(&g, (int) (total_resources[j] *
+                                                 g.contention) + 1);
+            held[j] = 0;
+            printf("\t%d", max_need[j]);
+        }
+        printf("\n");
+
+        length = next_random(&g, g.length) + 1;
+        for (k = 0; k < length; k++) {
+
+            kind = next_random(&g, g.mix[0] + g.mix[1] + g.mix[2]);
+
+            if (kind < g.mix[0]) {
+
+                printf("RQ");
+                for (j = 0; j < num_resources; j++) {
+                    values[j] = next_random(&g, max_need[j] - held[j] + 1);
+                    held[j] += values[j];
+                    printf("\t%d", values[j]);
+                }
+                printf("\n");
+
+            } else if (kind < g.mix[0] + g.mix[1]) {
+
+                printf("RL");
+                for (j = 0; j < num_resources; j++) {
+                    values[j] = next_random(&g, held[j] + 1);
+                    held[j] -= values[j];
+                    printf("\t%d", values[j]);
+                }
+                printf("\n");
+
+            } else {
+
+                printf("SL\t%d\n", next_random(&g, GENERATED_SLEEP) + 1);
+            }
+        }
+
+        printf("END\n");
+    }
+
+    free(max_need);
+    free(held);
+    free(values);
+    return 0;
+}
+
+/* Function to draw a number from 0 to bound - 1 with xorshift64*, so
+ * that a seed gives the same workload on every platform */
+int next_random(Generator *g, int bound) {
+
+    g->seed ^= g->seed >> 12;
+    g->seed ^= g->seed << 25;
+    g->seed ^= g->seed >> 27;
+
+    return (int) (((g->seed * 2685821657736338717ULL) >> 32) %
+                  (uint64_t) bound);
+}
+
+/* Function to read the jobs from the input file, or from standard input
+ * if path is NULL. The input is either a binary workload
+ * or text, where an optional 'RS' header before the first process gives
+ * the number and totals of the resources */
+int read_jobs(const char *path) {
+
+    int fd = 0;
+    int status;
+    Input in;
+
+    if (path != NULL) {
+
+        fd = open(path, O_RDONLY);
+        if (fd == -1) {
+            perror(path);
+            return -1;
+        }
+    }
+
+    if (load_input(&in, fd) == -1) {
+        return -1;
+    }
+
+    input_bytes = in.size;
+
+    /* a binary workload is used in place and stays loaded */
+    if (is_binary_workload(&in)) {
+        status = load_workload(&in);
+    } else {
+        status = parse_workload(&in);
+        unload_input(&in);
+    }
+
+    if (path != NULL) {
+        close(fd);
+    }
+
+    return status;
+}
+
+/* Function to 'sleep' a process */
+int sleep_process(Simulation *s, Process* p, int duration) {
+
+
+    /* remove the process from the queue */
+    leave_ready(s, p);
+    STATS_COUNT(sleeps);
+
+    /* with the clock the process sleeps until its wake up time */
+    if (timed_sleep) {
+
+        p->wake_time = s->clock_time + duration;
+        push_sleeper(s, p);
+        return 0;
+    }
+
+    /* reinitialize the queue if empty */
+    if (TAILQ_EMPTY(&s->ready_queue)) {
+
+        TAILQ_INIT(&s->ready_queue);
+    }
+
+    /* reinsert the process at the tail of the queue */
+    make_ready(s, p);
+
+    return 0;
+}
+
+/* Function to request resources for a process */
+int request_resources(Simulation *s, Process* p, int* resources) {
+
+    bool safe;
+    long start;
+
+    s->requests_count++;
+
+    /* if there are enough resources to satisfy the request,
+     * run safe check. Otherwise move to wait queue */
+    if (vector_less_equal(resources, s->available_matrix, num_resources)) {
+
+        /* deny the request if a safe state is not reached */
+        start = benchmark ? now_ns() : 0;
+        safe = is_safe_request(s, p, resources);
+        if (benchmark) {
+            record_latency(s, start);
+        }
+
+        if (!safe) {
+            deny_request(s, p, resources, TRACE_DENY_UNSAFE);
+            return -1;
+        }
+
+        /* keep the allocation made by the check, the reference makes it
+         * only now */
+        if (reference_checks) {
+            allocate_resources(s, p, resources);
+        } else {
+            commit_grants(s);
+        }
+        record_grant(s, p);
+        TRACE_EVENT(TRACE_GRANT, p->id, p->slot, s->clock_time, resources);
+        DECISION_EVENT(TRACE_GRANT, p->id, s->clock_time);
+
+     } else {
+
+         /* move to wait queue if resources are not available */
+         deny_request(s, p, resources, TRACE_DENY_UNAVAILABLE);
+         return -1;
+     }
+
+
+    return 0;
+}
+
+/* Function to report a request denied as unsafe or unavailable and move
+ * the process to wait for a release */
+void deny_request(Simulation *s, Process *p, int *resources, TraceType type) {
+
+    int i;
+
+    TRACE_EVENT(type, p->id, p->slot, s->clock_time, resources);
+    DECISION_EVENT(type, p->id, s->clock_time);
+
+    if (type == TRACE_DENY_UNSAFE) {
+
+        /* print info */
+        s->unsafe_count++;
+        if (!s->quiet) {
+            printf("Request of job No. %d for resources:", p->id);
+            for (i = 0; i < num_resources; i++) {
+                printf(" %d", resources[i]);
+            }
+            printf(" cannot be satisfied\n");
+            print_matrices(s);
+        }
+    } else {
+        s->unavailable_count++;
+    }
+
+    /* place in wait queue */
+    wait_process(s, p, resources);
+    if (preempt_policy != NULL) {
+        preempt_for(s, p);
+    }
+}
+
+/* Function to move resources from the available vector to the rows of
+ * the slot of a process */
+void allocate_resources(Simulation *s, Process *p, const int *resources) {
+
+    vector_add(p->allocated_resources, resources, num_resources);
+    vector_subtract(MATRIX_ROW(s->need_matrix, p->slot), resources,
+                    num_resources);
+    vector_subtract(s->available_matrix, resources, num_resources);
+}
+
+/* Function to move resources from the rows of the slot of a process back
+ * to the available vector */
+void deallocate_resources(Simulation *s, Process *p, const int *resources) {
+
+    vector_subtract(p->allocated_resources, resources, num_resources);
+    vector_add(MATRIX_ROW(s->need_matrix, p->slot), resources, num_resources);
+    vector_add(s->available_matrix, resources, num_resources);
+}
+
+/* Function to grant resources to a process tentatively, logging the
+ * grant so that abort_grants() can roll it back */
+void tentative_grant(Simulation *s, Process *p, const int *resources) {
+
+    allocate_resources(s, p, resources);
+    s->undo_log[s->undo_count].process = p;
+    s->undo_log[s->undo_count].resources = resources;
+    s->undo_count++;
+}
+
+/* Function to keep the tentative grants */
+void commit_grants(Simulation *s) {
+
+    s->undo_count = 0;
+}
+
+/* Function to roll back the tentative grants, latest first */
+void abort_grants(Simulation *s) {
+
+    UndoEntry *entry;
+
+    STATS_COUNT(rollbacks);
+    while (s->undo_count > 0) {
+        entry = &s->undo_log[--s->undo_count];
+        deallocate_resources(s, entry->process, entry->resources);
+    }
+}
+
+/* Function to note that the request of a process was granted */
+void record_grant(Simulation *s, Process *p) {
+
+    /* the process starts holding resources with its first grant */
+    if (p->hold_start == -1) {
+        p->hold_start = s->clock_time;
+    }
+
+    /* every grant renews the lease on what it holds */
+    if (LEASES_KEPT()) {
+        renew_lease(s, p);
+    }
+
+    /* and changes its remaining need */
+    update_ready(s, p);
+
+    /* it waits at the back of the line for its next request */
+    p->wait_sequence = -1;
+}
+
+/* Function to check if granting a request keeps the system in a safe
+ * state. Only the processes ahead of p in the cached safe sequence see
+ * less available resources after the grant, so only that prefix is
+ * re-verified. A full check is run if the prefix no longer holds. A safe
+ * request is left granted tentatively for the caller to commit, and an
+ * unsafe one is rolled back */
+bool is_safe_request(Simulation *s, Process *p, int *resources) {
+
+    bool safe;
+
+    /* the reference checks the whole state from scratch every time and
+     * leaves nothing allocated */
+    if (reference_checks) {
+        allocate_resources(s, p, resources);
+        safe = is_safe_reference(s, NULL);
+        deallocate_resources(s, p, resources);
+        return safe;
+    }
+
+    if (s->safe_sequence_valid && safe_prefix_check(s, p, resources)) {
+        STATS_COUNT(prefix_checks);
+        tentative_grant(s, p, resources);
+        return true;
+    }
+
+    /* make the allocation tentatively and run the full check */
+    tentative_grant(s, p, resources);
+    if (!safe_state_check(s, s->safe_rows)) {
+        abort_grants(s);
+        return false;
+    }
+
+    /* the new sequence stays valid after the grant is committed */
+    adopt_safe_sequence(s, s->safe_rows);
+    return true;
+}
+
+/* Function to check that the processes ahead of p in the cached safe
+ * sequence can still finish in order after resources are granted to p.
+ * Returns false if one of them cannot, or p is not in the sequence */
+bool is_safe_prefix(Simulation *s, Process *p, const int *resources) {
+
+    Process *q;
+
+    /* resources available to the prefix after the grant */
+    memcpy(s->work, s->available_matrix, num_resources * sizeof(int));
+    vector_subtract(s->work, resources, num_resources);
+
+    /* walk the prefix until p is reached */
+    TAILQ_FOREACH(q, &s->safe_queue, safe_processes) {
+
+        /* every process after p sees the same resources as before */
+        if (q == p) {
+            return true;
+        }
+
+        if (!vector_difference_less_equal(q->max_need, q->allocated_resources,
+                                          s->work, num_resources)) {
+            return false;
+        }
+
+        /* release the resources of the finished process */
+        vector_add(s->work, q->allocated_resources, num_resources);
+    }
+
+    return false;
+}
+
+/* Function to replace the cached safe sequence with the slots found by
+ * is_safe_state() */
+void adopt_safe_sequence(Simulation *s, int *sequence) {
+
+    int i;
+
+    /* rebuild the safe sequence in the order found */
+    TAILQ_INIT(&s->safe_queue);
+    for (i = 0; i < s->held_count; i++) {
+        TAILQ_INSERT_TAIL(&s->safe_queue, s->slot_processes[sequence[i]],
+                          safe_processes);
+    }
+
+    s->safe_sequence_valid = true;
+}
+
+/* Function to add a newly admitted process to the end of the cached
+ * safe sequence. Every process ahead of it has finished by then, so it
+ * only has to fit in the total resources */
+void admit_to_safe_sequence(Simulation *s, Process *p) {
+
+    if (!s->safe_sequence_valid) {
+        return;
+    }
+
+    if (vector_difference_less_equal(p->max_need, p->allocated_resources,
+                                     s->total_resources, num_resources)) {
+
+        TAILQ_INSERT_TAIL(&s->safe_queue, p, safe_processes);
+    } else {
+
+        /* no safe sequence exists until a full check finds one */
+        TAILQ_INIT(&s->safe_queue);
+        s->safe_sequence_valid = false;
+    }
+}
+
+/* Function to release resrouces from a process */
+int release_resources(Simulation *s, Process* p, int* resources) {
+
+    /* if the process tried to release more resources than it has,
+     * terminate the process */
+    if (vector_less_equal(resources, p->allocated_resources,
+                          num_resources)) {
+
+        /* release resouces */
+        deallocate_resources(s, p, resources);
+        update_ready(s, p);
+        TRACE_EVENT(TRACE_RELEASE, p->id, p->slot, s->clock_time, resources);
+
+        /* the process stops holding resources once it has none left */
+        if (p->hold_start != -1 && !holds_resources(p)) {
+            p->hold_time += s->clock_time - p->hold_start;
+            p->hold_start = -1;
+            drop_lease(s, p);
+        }
+
+        /* move the waiters that can now be satisfied to the ready queue */
+        wake_waiters(s, resources);
+
+    } else {
+
+        /* abnormally terminate the process, which wakes the waiters
+         * its resources can satisfy */
+        terminate_process(s, p);
+
+        /* the broadcast policy wakes every waiter instead */
+        if (wake_policy == WAKE_ALL) {
+            wake_waiters(s, NULL);
+        }
+
+        /* return -1, indicated error */
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Function to find the first resource a request is short on, or -1 if
+ * every resource of the request is available */
+int short_dimension(Simulation *s, int *resources) {
+
+    int i;
+
+    for (i = 0; i < num_resources; i++) {
+        if (resources[i] > s->available_matrix[i]) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Function to move a process from the ready queue to wait for resources.
+ * A process short on resources waits on the queue of the first resource
+ * it is short on, so that only releases of that resource look at it. A
+ * process denied as unsafe waits on wait_queue for any release */
+void wait_process(Simulation *s, Process *p, int *resources) {
+
+    leave_ready(s, p);
+    STATS_COUNT(waits);
+
+    /* the process keeps its place in line until its request is granted */
+    if (p->wait_sequence == -1) {
+        p->wait_sequence = s->wait_sequence++;
+    }
+    p->wait_start = s->clock_time;
+
+    p->wait_dimension = -1;
+    if (wake_policy != WAKE_ALL) {
+        p->wait_dimension = short_dimension(s, resources);
+    }
+
+    if (p->wait_dimension == -1) {
+        TAILQ_INSERT_TAIL(&s->wait_queue, p, processes);
+    } else {
+        TAILQ_INSERT_TAIL(&s->wait_lists[p->wait_dimension], p, processes);
+    }
+}
+
+/* Function to order woken processes, oldest waiter first, or highest
+ * priority first with the policy WAKE_PRIORITY */
+int compare_waiters(const void *a, const void *b) {
+
+    const Process *p = *(Process * const *) a;
+    const Process *q = *(Process * const *) b;
+
+    if (wake_policy == WAKE_PRIORITY && p->priority != q->priority) {
+        return p->priority > q->priority ? -1 : 1;
+    }
+
+    return (p->wait_sequence > q->wait_sequence) -
+           (p->wait_sequence < q->wait_sequence);
+}
+
+/* Function to move the waiters whose request can now pass the
+ * availability test to the ready queue after the resources released
+ * were returned. Only the queues of the resources released are looked
+ * at, and a waiter still short on another resource moves to its queue.
+ * With the policy WAKE_ALL every waiter is moved and released is unused */
+void wake_waiters(Simulation *s, const int *released) {
+
+    int i;
+    int count = 0;
+    int dimension;
+    Process *p;
+    Process *next;
+    Instruction *inst;
+
+    if (wake_policy == WAKE_ALL) {
+
+        while (!TAILQ_EMPTY(&s->wait_queue)) {
+
+            p = TAILQ_FIRST(&s->wait_queue);
+            TAILQ_REMOVE(&s->wait_queue, p, processes);
+            s->woken_rows[count++] = p;
+        }
+
+    } else {
+
+        /* waiters denied as unsafe are retried if their request is still
+         * available, as the release may have made it safe */
+        for (p = TAILQ_FIRST(&s->wait_queue); p != NULL; p = next) {
+
+            next = TAILQ_NEXT(p, processes);
+            inst = INSTRUCTION_AT(p->instructions, p->current_instruction);
+            dimension = short_dimension(s, inst->values);
+
+            TAILQ_REMOVE(&s->wait_queue, p, processes);
+            if (dimension == -1) {
+                s->woken_rows[count++] = p;
+            } else {
+                p->wait_dimension = dimension;
+                TAILQ_INSERT_TAIL(&s->wait_lists[dimension], p, processes);
+            }
+        }
+
+        for (i = 0; i < num_resources; i++) {
+
+            if (released[i] == 0) {
+                continue;
+            }
+
+            for (p = TAILQ_FIRST(&s->wait_lists[i]); p != NULL; p = next) {
+
+                next = TAILQ_NEXT(p, processes);
+                inst = INSTRUCTION_AT(p->instructions,
+                                      p->current_instruction);
+                dimension = short_dimension(s, inst->values);
+
+                if (dimension == i) {
+                    continue;
+                }
+
+                TAILQ_REMOVE(&s->wait_lists[i], p, processes);
+                if (dimension == -1) {
+                    s->woken_rows[count++] = p;
+                } else {
+                    p->wait_dimension = dimension;
+                    TAILQ_INSERT_TAIL(&s->wait_lists[dimension], p, processes);
+                }
+            }
+        }
+
+        /* retry the woken processes in the order of the policy */
+        qsort(s->woken_rows, count, sizeof(Process *), compare_waiters);
+    }
+
+    STATS_ADD(wakes, count);
+    for (i = 0; i < count; i++) {
+        make_ready(s, s->woken_rows[i]);
+        s->woken_rows[i]->wait_time += s->clock_time - s->woken_rows[i]->wait_start;
+    }
+}
+
+/* Function to check if a process holds any resources */
+bool holds_resources(Process *p) {
+
+    int i;
+
+    for (i = 0; i < num_resources; i++) {
+        if (p->allocated_resources[i] != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Function to order sleeping processes by wake up time, and processes
+ * waking at the same time in the order they went to sleep */
+bool sleeps_before(Process *p, Process *q) {
+
+    if (p->wake_time != q->wake_time) {
+        return p->wake_time < q->wake_time;
+    }
+
+    return p->sleep_sequence < q->sleep_sequence;
+}
+
+/* Function to add a process to the heap of sleeping processes */
+void push_sleeper(Simulation *s, Process *p) {
+
+    int i = s->sleepers_count++;
+    int parent;
+
+    p->sleep_sequence = s->sleep_sequence++;
+
+    /* move the process up past the parents that wake after it */
+    while (i > 0) {
+
+        parent = (i - 1) / 2;
+        if (!sleeps_before(p, s->sleepers[parent])) {
+            break;
+        }
+        s->sleepers[i] = s->sleepers[parent];
+        i = parent;
+    }
+
+    s->sleepers[i] = p;
+}
+
+/* Function to remove the process waking first from the heap */
+Process *pop_sleeper(Simulation *s) {
+
+    Process *first = s->sleepers[0];
+
+    remove_sleeper(s, 0);
+    return first;
+}
+
+/* Function to remove the process at index i from the heap of sleeping
+ * processes */
+void remove_sleeper(Simulation *s, int i) {
+
+    int child;
+    int parent;
+    Process *last = s->sleepers[--s->sleepers_count];
+
+    if (i == s->sleepers_count) {
+        return;
+    }
+
+    /* move the last process up past the parents that wake after it */
+    while (i > 0) {
+
+        parent = (i - 1) / 2;
+        if (!sleeps_before(last, s->sleepers[parent])) {
+            break;
+        }
+        s->sleepers[i] = s->sleepers[parent];
+        i = parent;
+    }
+
+    /* move it down past the children that wake before it */
+    while ((child = 2 * i + 1) < s->sleepers_count) {
+
+        if (child + 1 < s->sleepers_count &&
+            sleeps_before(s->sleepers[child + 1], s->sleepers[child])) {
+            child++;
+        }
+        if (!sleeps_before(s->sleepers[child], last)) {
+            break;
+        }
+        s->sleepers[i] = s->sleepers[child];
+        i = child;
+    }
+
+    s->sleepers[i] = last;
+}
+
+/* Function to move the processes whose wake up time has come to the
+ * ready queue, in the order they wake up */
+void wake_sleepers(Simulation *s) {
+
+    Process *p;
+
+    while (s->sleepers_count > 0 && s->sleepers[0]->wake_time <= s->clock_time) {
+        p = pop_sleeper(s);
+        make_ready(s, p);
+    }
+}
+
+/* Function to add a process to the tail of the ready queue, and to the
+ * ready heap of a scheduler other than FIFO */
+void make_ready(Simulation *s, Process *p) {
+
+    TAILQ_INSERT_TAIL(&s->ready_queue, p, processes);
+
+    if (scheduler->runs_before != NULL) {
+        p->ready_sequence = s->ready_sequence++;
+        p->ready_index = s->ready_count;
+        s->ready_heap[s->ready_count++] = p;
+        place_ready(s, p->ready_index);
+    }
+}
+
+/* Function to remove a process from the ready queue and the ready heap */
+void leave_ready(Simulation *s, Process *p) {
+
+    int i = p->ready_index;
+
+    TAILQ_REMOVE(&s->ready_queue, p, processes);
+
+    if (i == -1) {
+        return;
+    }
+
+    /* the last process takes the place of the one removed */
+    p->ready_index = -1;
+    s->ready_count--;
+    if (i < s->ready_count) {
+        s->ready_heap[i] = s->ready_heap[s->ready_count];
+        place_ready(s, i);
+    }
+}
+
+/* Function to move the process at index i of the ready heap up or down
+ * to its place in the order of the scheduler */
+void place_ready(Simulation *s, int i) {
 
-    /* initialize queues for storing processes */
-    TAILQ_INIT(&ready_queue);
-    TAILQ_INIT(&wait_queue);
-    TAILQ_INIT(&standby_queue);
-    TAILQ_INIT(&hold_queue);
+    int child;
+    int parent;
+    Process *p = s->ready_heap[i];
 
-    /* build the initial resource availability matrix */
-    available_matrix[0] = R1;
-    available_matrix[1] = R2;
-    available_matrix[2] = R3;
-    available_matrix[3] = R4;
-
-    /* build the standby queue */
-    if (build_standby_queue() == -1) {
-        printf("Could not parse data");
-        return 0;
+    while (i > 0) {
+
+        parent = (i - 1) / 2;
+        if (!scheduler->runs_before(p, s->ready_heap[parent])) {
+            break;
+        }
+        s->ready_heap[i] = s->ready_heap[parent];
+        s->ready_heap[i]->ready_index = i;
+        i = parent;
     }
 
-    /* build the ready queue */
-    Process *p;
-    for (i = 0; i < 5; i++) {
-        p = TAILQ_FIRST(&standby_queue);
-        TAILQ_REMOVE(&standby_queue, p, processes);
-        TAILQ_INSERT_TAIL(&hold_queue, p, hold_processes);
-        TAILQ_INSERT_TAIL(&ready_queue, p, processes);
+    while ((child = 2 * i + 1) < s->ready_count) {
+
+        if (child + 1 < s->ready_count &&
+            scheduler->runs_before(s->ready_heap[child + 1],
+                                   s->ready_heap[child])) {
+            child++;
+        }
+        if (!scheduler->runs_before(s->ready_heap[child], p)) {
+            break;
+        }
+        s->ready_heap[i] = s->ready_heap[child];
+        s->ready_heap[i]->ready_index = i;
+        i = child;
     }
 
-    /* build the initial resource availability matrix */
-    available_matrix[0] = R1;
-    available_matrix[1] = R2;
-    available_matrix[2] = R3;
-    available_matrix[3] = R4;
+    s->ready_heap[i] = p;
+    p->ready_index = i;
+}
 
-    /* build the initial allocation matrix */
-    build_allocation_matrix();
+/* Function to move a ready process to its new place after its
+ * allocation changed */
+void update_ready(Simulation *s, Process *p) {
 
-    /* build the initial max_need_matrix */
-    build_max_need_matrix();
+    if (p->ready_index != -1) {
+        place_ready(s, p->ready_index);
+    }
+}
 
-    /* build the initial need_matrix */
-    build_need_matrix();
+/* Function to order ready processes by priority, highest first, then in
+ * the order they became ready */
+bool runs_by_priority(Process *p, Process *q) {
 
-    /* run the processes */
-    run_processes();
+    if (p->priority != q->priority) {
+        return p->priority > q->priority;
+    }
 
-    return 0;
+    return p->ready_sequence < q->ready_sequence;
 }
 
-/* Function to create a process from a character array */
-Process create_process(char* data) {
+/* Function to order ready processes by the units of resources they still
+ * need, fewest first, then in the order they became ready */
+bool runs_by_need(Process *p, Process *q) {
 
-    /* variables for loops */
-    int i, j;
-    int index = 0;
+    long p_need = need_units(p);
+    long q_need = need_units(q);
 
-    /* skips until the 'D' in 'ID' */
-    while (data[index] != 'D') {
-        index++;
+    if (p_need != q_need) {
+        return p_need < q_need;
     }
-    index++;
 
-    /* skips whitespace until the ID number */
-    while (isspace(data[index])) {
-        index++;
+    return p->ready_sequence < q->ready_sequence;
+}
+
+/* Function to order ready processes by deadline, earliest first, then in
+ * the order they became ready */
+bool runs_by_deadline(Process *p, Process *q) {
+
+    if (p->deadline != q->deadline) {
+        return p->deadline < q->deadline;
     }
 
-    /* temp variables for storing the read ID number as chars */
-    char id_num[5] = {'\0', '\0', '\0', '\0', '\0'};
-    i = 0;
+    return p->ready_sequence < q->ready_sequence;
+}
 
-    /* store each char as long as it is a digit */
-    while (isdigit(data[index])) {
-        id_num[i] = data[index];
-        index++;
-        i++;
+/* Function to count the units of every resource a process still needs */
+long need_units(Process *p) {
+
+    int i;
+    long units = 0;
+
+    for (i = 0; i < num_resources; i++) {
+        units += p->max_need[i] - p->allocated_resources[i];
     }
 
-    /* skip whitespace until next instruction */
-    while (isspace(data[index]) || data[index] == 'M' || data[index] == 'N') {
-        index++;
+    return units;
+}
+
+/* Function to pick the job to admit with --admission from the next
+ * admission_window jobs on standby: the one most likely to be granted
+ * safely. A job whose max need fits in what is available can run to the
+ * end without waiting, otherwise the job short of the fewest units goes
+ * first, and ties go to the earliest in the input. A job passed over
+ * admission_window times is admitted first so that none starves. Returns
+ * the index of the job, or -1 if none is left */
+int choose_standby(Simulation *s) {
+
+    int i, j;
+    int best = -1;
+    int index;
+    long shortfall;
+    long best_shortfall = LONG_MAX;
+
+    /* fill the window in input order */
+    while (s->standby_count < admission_window && s->next_job < procs_count) {
+        s->standby[s->standby_count] = s->next_job++;
+        s->standby_skips[s->standby_count] = 0;
+        s->standby_count++;
     }
 
-    int temp_max_need[4];
+    if (s->standby_count == 0) {
+        return -1;
+    }
 
-    /* loop to get the max need for the process */
-    for(j = 0; j < 4; j++) {
+    for (i = 0; i < s->standby_count; i++) {
 
-        /* variables for storing the max need as chars */
-        char temp_max_need_chars[4] = {'\0', '\0', '\0', '\0'};
-        i = 0;
+        if (s->standby_skips[i] >= admission_window) {
+            best = i;
+            break;
+        }
 
-        /* skip whitespace until next number */
-        while (isspace(data[index])) {
-            index++;
+        shortfall = 0;
+        for (j = 0; j < num_resources; j++) {
+            if (procs[s->standby[i]].max_need[j] > s->available_matrix[j]) {
+                shortfall += procs[s->standby[i]].max_need[j] -
+                             s->available_matrix[j];
+            }
         }
 
-        /* get the next digit */
-        while (isdigit(data[index])) {
-            temp_max_need_chars[i] = data[index];
-            index++;
-            i++;
+        if (shortfall < best_shortfall) {
+            best = i;
+            best_shortfall = shortfall;
         }
+    }
 
-        /* convert the max need from chars to an int */
-        temp_max_need[j] = atoi(temp_max_need_chars);
+    /* the jobs before it were passed over, the window keeps its order */
+    index = s->standby[best];
+    for (i = 0; i < best; i++) {
+        s->standby_skips[i]++;
+    }
+    for (i = best; i + 1 < s->standby_count; i++) {
+        s->standby[i] = s->standby[i + 1];
+        s->standby_skips[i] = s->standby_skips[i + 1];
     }
+    s->standby_count--;
 
-    /* set max need of process */
-    temp.max_need[0] = temp_max_need[0];
-    temp.max_need[1] = temp_max_need[1];
-    temp.max_need[2] = temp_max_need[2];
-    temp.max_need[3] = temp_max_need[3];
+    return index;
+}
 
-    /* variables to store the instructions */
-    int instruction_counter = 0;
-    Instruction inst[50];
+/* Function to order leases by expiry, and leases expiring at the same
+ * time in the order they were renewed */
+bool expires_before(Process *p, Process *q) {
 
-    /* loop until buffer 'END', the final instruction */
-    while (true) {
+    if (p->lease_expiry != q->lease_expiry) {
+        return p->lease_expiry < q->lease_expiry;
+    }
 
-        Instruction temp_instruction;
+    return p->lease_sequence < q->lease_sequence;
+}
 
-        char temp_inst_id[4] = {'\0', '\0', '\0', '\0'};
+/* Function to move the lease at index i of the heap up or down to its
+ * place after its expiry changed */
+void place_lease(Simulation *s, int i) {
 
-        while (isspace(data[index])) {
-            index++;
-        }
+    int child;
+    int parent;
+    Process *p = s->leases[i];
 
-        int k = 0;
-        while (isalpha(data[index])) {
+    while (i > 0) {
 
-            temp_inst_id[k] = data[index];
-            k++;
-            index++;
+        parent = (i - 1) / 2;
+        if (!expires_before(p, s->leases[parent])) {
+            break;
         }
+        s->leases[i] = s->leases[parent];
+        s->leases[i]->lease_index = i;
+        i = parent;
+    }
 
-        /* check if the beginning of the instruction is 'E',
-         * signaling the final instruction */
-        if (temp_inst_id[0] == 'E') {
-
-            /* create the final instruction */
-            temp_instruction = (Instruction) {
-                .id[0] = 'E',
-                .id[1] = 'N',
-                .id[2] = 'D',
-                .id[3] = '\0',
-                .values[0] = 0,
-                .values[1] = 0,
-                .values[2] = 0,
-                .values[3] = 0
-            };
+    while ((child = 2 * i + 1) < s->leases_count) {
 
-            /* store the final instruction and exit the loop */
-            temp.instructions[instruction_counter] = temp_instruction;
-            instruction_counter++;
+        if (child + 1 < s->leases_count &&
+            expires_before(s->leases[child + 1], s->leases[child])) {
+            child++;
+        }
+        if (!expires_before(s->leases[child], p)) {
             break;
         }
+        s->leases[i] = s->leases[child];
+        s->leases[i]->lease_index = i;
+        i = child;
+    }
 
-        /* array to store numbers from buffer */
-        int temp_numbers[4] = {0, 0, 0, 0};
-
-        /* loop through buffer contents 4 times to get the
-         * 4 associated numbers */
-        for(j = 0; j < 4; j++) {
+    s->leases[i] = p;
+    p->lease_index = i;
+}
 
-            /* variables to parse buffer contents */
-            i = 0;
-            char temp_number_chars[4] = {'\0', '\0', '\0', '\0'};
+/* Function to start or renew the lease of a process on the resources it
+ * holds. Without --lease the lease never expires, but may be preempted */
+void renew_lease(Simulation *s, Process *p) {
 
-            /* skip whitespace */
-            while (isspace(data[index])) {
-                index++;
-            }
+    /* a preempted process keeps its lease expired */
+    if (p->preempted) {
+        return;
+    }
 
-           /* read input while it is a number */
-            while (isdigit(data[index])) {
-                temp_number_chars[i] = data[index];
-                index++;
-                i++;
-            }
+    p->lease_expiry = lease_ticks > 0 ? s->clock_time + lease_ticks : LONG_MAX;
+    p->lease_sequence = s->lease_sequence++;
 
-            /* convery chars to ints */
-            temp_numbers[j] = atoi(temp_number_chars);
-        }
+    if (p->lease_index == -1) {
+        p->lease_index = s->leases_count;
+        s->leases[s->leases_count++] = p;
+    }
 
-        /* create a temporary instruction */
-        temp_instruction = (Instruction) {
-            .id[0] = temp_inst_id[0],
-            .id[1] = temp_inst_id[1],
-            .id[2] = temp_inst_id[2],
-            .id[3] = temp_inst_id[3],
-            .values[0] = temp_numbers[0],
-            .values[1] = temp_numbers[1],
-            .values[2] = temp_numbers[2],
-            .values[3] = temp_numbers[3]
-        };
+    place_lease(s, p->lease_index);
+}
 
-        /* store each instruction into an array of instructions */
-        temp.instructions[instruction_counter] = temp_instruction;
-        instruction_counter++;
-    }
+/* Function to end the lease of a process once it holds nothing */
+void drop_lease(Simulation *s, Process *p) {
 
+    int i = p->lease_index;
 
-    /* populate the temp process' data */
-    temp.id = atoi(id_num);
-    temp.instruction_counter = instruction_counter;
+    if (i == -1) {
+        return;
+    }
 
-    return temp;
+    /* the last lease takes the place of the one dropped */
+    p->lease_index = -1;
+    s->leases_count--;
+    if (i < s->leases_count) {
+        s->leases[i] = s->leases[s->leases_count];
+        place_lease(s, i);
+    }
 }
 
-/* Function to terminate a process and release all resources allocated to it */
-int terminate_process(Process* p) {
-
-    int i, j;
-    Process *temp_process;
+/* Function to take back the resources of the processes whose lease has
+ * expired or that were preempted, in the order of expiry */
+void expire_leases(Simulation *s) {
 
-    /* release allocated resources */
-    for (i = 0; i < 4; i++) {
-        available_matrix[i] = available_matrix[i] + p->allocated_resources[i];
-        p->allocated_resources[i] = 0;
-    }
+    Process *p;
 
-    /* remove from ready_queue */
-    TAILQ_REMOVE(&ready_queue, p, processes);
-    TAILQ_REMOVE(&hold_queue, p, hold_processes);
+    while (s->leases_count > 0 &&
+           s->leases[0]->lease_expiry <= s->clock_time) {
 
-    /* return if no more processes to load */
-    if (TAILQ_EMPTY(&standby_queue)) {
-        return 0;
-    }
+        p = s->leases[0];
 
-    /* add next process to the ready_queue */
-    temp_process = TAILQ_FIRST(&standby_queue);
-    TAILQ_REMOVE(&standby_queue, temp_process, processes);
-    TAILQ_INSERT_TAIL(&hold_queue, temp_process, hold_processes);
-    TAILQ_INSERT_TAIL(&ready_queue, temp_process, processes);
+        if (p->preempted) {
+            s->preempted_count++;
+        } else {
+            s->expired_count++;
+        }
 
-    /* rebuild all matrices */
-    build_max_need_matrix();
-    build_allocation_matrix();
-    build_need_matrix();
+        if (!s->quiet) {
+            printf("%s of job No. %d, its resources are taken back\n",
+                   p->preempted ? "Preemption" : "Lease expiry", p->id);
+        }
 
-    return 0;
+        reclaim_process(s, p);
+    }
 }
 
-/* Function to run processes from the ready_queue */
-void run_processes() {
+/* Function to terminate a process before it is done to take back its
+ * resources, waking the waiters they satisfy. Reclaims are rare, so the
+ * queue the process is on is looked up rather than tracked */
+void reclaim_process(Simulation *s, Process *p) {
 
-    Process* p;
+    int i;
+    Process *q;
 
-    /* loop until ready_queue is empty */
-    while(true) {
+    /* a sleeper leaves the heap and a waiter its wait queue, either
+     * joining the ready queue to be terminated */
+    for (i = 0; i < s->sleepers_count && s->sleepers[i] != p; i++);
 
-        /* get the first entry in the ready queue */
-        if (TAILQ_EMPTY(&ready_queue)) {
+    if (i < s->sleepers_count) {
 
-            return;
-        } else {
+        remove_sleeper(s, i);
+        make_ready(s, p);
+    } else {
 
-            p = TAILQ_FIRST(&ready_queue);
+        TAILQ_FOREACH(q, &s->ready_queue, processes) {
+            if (q == p) {
+                break;
+            }
         }
 
-        /* execute the next instruction */
-        execute_instruction(p, &p->instructions[p->current_instruction]);
+        if (q == NULL) {
 
+            if (p->wait_dimension == -1) {
+                TAILQ_REMOVE(&s->wait_queue, p, processes);
+            } else {
+                TAILQ_REMOVE(&s->wait_lists[p->wait_dimension], p, processes);
+            }
+            p->wait_time += s->clock_time - p->wait_start;
+            make_ready(s, p);
+        }
     }
-}
 
-/* Function to execute an instruction */
-void execute_instruction(Process* p, Instruction *inst) {
+    p->reclaimed = true;
+    terminate_process(s, p);
 
-    /* determine the instruction and execute accordingly */
-    if (inst->id[0] == 'R' && inst->id[1] == 'Q') {
+    /* the broadcast policy wakes every waiter instead */
+    if (wake_policy == WAKE_ALL) {
+        wake_waiters(s, NULL);
+    }
+}
 
-        /* if request is granted, increment current_instruction */
-        if(request_resources(p, inst->values) == 0) {
-            p->current_instruction += 1;
-            return;
-        }
+/* Function to preempt processes for a process denied its request, if
+ * the policy lists victims whose resources let it finish. The victims
+ * are taken in order until its whole remaining need is available, which
+ * makes its request safe. Their leases expire at once, so their
+ * resources are taken back before the next instruction runs */
+void preempt_for(Simulation *s, Process *p) {
 
-    }
-    else if (inst->id[0] == 'R' && inst->id[1] == 'L') {
+    int i;
+    int count;
+    int *need = MATRIX_ROW(s->need_matrix, p->slot);
 
-        /* release desired resources */
-        release_resources(p, inst->values);
-        p->current_instruction += 1;
+    if (p->preempted) {
         return;
     }
-    else if (inst->id[0] == 'S' && inst->id[1] == 'L') {
 
-        /* sleep the current process */
-        sleep_process(p);
-        p->current_instruction += 1;
-        return;
+    count = preempt_policy(s, p, s->victims);
+
+    memcpy(s->work, s->available_matrix, num_resources * sizeof(int));
+    for (i = 0; i < count; i++) {
+
+        vector_add(s->work, s->victims[i]->allocated_resources, num_resources);
+        if (vector_less_equal(need, s->work, num_resources)) {
+            break;
+        }
     }
-    else if (inst->id[0] == 'E' && inst->id[1] == 'N') {
 
-        /* terminate the current process */
-        terminate_process(p);
+    /* nobody is preempted if the victims are not enough */
+    if (i == count) {
         return;
     }
 
-    return;
+    for (; i >= 0; i--) {
+        s->victims[i]->preempted = true;
+        s->victims[i]->lease_expiry = s->clock_time;
+        place_lease(s, s->victims[i]->lease_index);
+    }
 }
 
-/* Function to build the standby_queue */
-int build_standby_queue() {
+/* Function to list the processes holding resources that p may preempt,
+ * those of lower priority. The lowest priority are preempted first, and
+ * of the same priority those holding the most. Returns the number
+ * listed */
+int victims_by_priority(Simulation *s, Process *p, Process **victims) {
 
-    int bytes_read;
     int i;
-    char c;
-    char buffer[512];
-
-    /* parse the file one processes at a time */
-    while(true) {
-
-        i = 0;
-        for (i; i < 512; i++) {
-            buffer[i] = '\0';
-        }
+    int count = 0;
 
-        i = 0;
-
-        /* read each process one byte at a time */
-        while((bytes_read = read(0, &c, 1)) > 0 && c != 'E') {
-            buffer[i] = c;
-            i++;
+    for (i = 0; i < s->leases_count; i++) {
+        if (s->leases[i]->priority < p->priority) {
+            victims[count++] = s->leases[i];
         }
+    }
 
-        /* return if no bytes read (EOF) */
-        if (bytes_read == 0) {
-            return 0;
-        }
+    qsort(victims, count, sizeof(Process *), compare_victims);
+    return count;
+}
 
-        /* place END in the buffer for last instruction */
-        if (c == 'E') {
-            buffer[i    ] = 'E';
-            buffer[i + 1] = 'N';
-            buffer[i + 2] = 'D';
+/* Function to order victims by priority, then by how much they hold,
+ * then by slot */
+int compare_victims(const void *a, const void *b) {
 
-            /* advance the reader by 2 characters */
-            bytes_read = read(0, &c, 1);
-            bytes_read = read(0, &c, 1);
-        }
+    Process *p = *(Process * const *) a;
+    Process *q = *(Process * const *) b;
+    long p_held;
+    long q_held;
 
-        /* create and store process in queue */
-        procs[procs_count] = create_process(buffer);
-        TAILQ_INSERT_TAIL(&standby_queue, &procs[procs_count], processes);
-        procs_count++;
+    if (p->priority != q->priority) {
+        return p->priority < q->priority ? -1 : 1;
+    }
 
+    p_held = held_units(p);
+    q_held = held_units(q);
+    if (p_held != q_held) {
+        return p_held > q_held ? -1 : 1;
     }
 
-    /* immediately return -1 if loop is not entered */
-    return -1;
+    return p->slot - q->slot;
 }
 
-/* Function to 'sleep' a process */
-int sleep_process(Process* p) {
+/* Function to count the units of every resource a process holds */
+long held_units(Process *p) {
+
+    int i;
+    long units = 0;
 
+    for (i = 0; i < num_resources; i++) {
+        units += p->allocated_resources[i];
+    }
 
-    /* remove the process from the queue */
-    TAILQ_REMOVE(&ready_queue, p, processes);
+    return units;
+}
 
-    /* reinitialize the queue if empty */
-    if (TAILQ_EMPTY(&ready_queue)) {
+/* Function to print the turnaround, waiting and holding time of every
+ * process that ran, in ticks of the simulated clock. Every instruction
+ * takes one tick and all processes are submitted at time 0, so a job
+ * meets its deadline if it finishes by that tick. Jobs whose resources
+ * were taken back are counted apart, neither finished nor missing their
+ * deadline */
+void print_times(Simulation *s) {
 
-        TAILQ_INIT(&ready_queue);
-    }
+    int i;
+    int count = 0;
+    int reclaimed = 0;
+    int deadlines = 0;
+    int met = 0;
+    long turnaround = 0;
+    long waiting = 0;
+    long holding = 0;
 
-    /* reinsert the process at the tail of the queue */
-    TAILQ_INSERT_TAIL(&ready_queue, p, processes);
+    printf("\nJob\tTurnaround\tWait\tHolding\n");
 
-    return 0;
-}
+    for (i = 0; i < procs_count; i++) {
 
-/* Function to request resources for a process */
-int request_resources(Process* p, int* resources) {
+        if (s->times[i].finish_time == 0) {
+            continue;
+        }
 
-    int i, j;
+        if (s->times[i].reclaimed) {
+            reclaimed++;
+            continue;
+        }
 
-    /* if there are enough resources to satisfy the request,
-     * run safe check. Otherwise move to wait queue */
-    if (resources[0] <= available_matrix[0] &&
-        resources[1] <= available_matrix[1] &&
-        resources[2] <= available_matrix[2] &&
-        resources[3] <= available_matrix[3]) {
+        printf("%d\t%ld\t\t%ld\t%ld\n", procs[i].id, s->times[i].finish_time,
+               s->times[i].wait_time, s->times[i].hold_time);
+        turnaround += s->times[i].finish_time;
+        waiting += s->times[i].wait_time;
+        holding += s->times[i].hold_time;
+        count++;
+    }
 
-        /* make allocation */
-        for (i = 0; i < 4; i++) {
-            p->allocated_resources[i] = p->allocated_resources[i] +
-                                        resources[i];
+    for (i = 0; i < procs_count; i++) {
 
-            available_matrix[i] = available_matrix[i] - resources[i];
+        if (procs[i].deadline == INT_MAX || s->times[i].reclaimed) {
+            continue;
         }
 
-        /* rebuild matrices */
-        build_allocation_matrix();
-        build_need_matrix();
+        deadlines++;
+        if (s->times[i].finish_time != 0 &&
+            s->times[i].finish_time <= procs[i].deadline) {
+            met++;
+        }
+    }
 
-        /* roll back if safe state is not reached */
-        if (!is_safe_state()) {
+    printf("Finished %d of %d jobs in %ld ticks\n", count, procs_count,
+           s->clock_time);
+    if (count > 0) {
+        printf("Average\t%.1f\t\t%.1f\t%.1f\n", (double) turnaround / count,
+               (double) waiting / count, (double) holding / count);
+    }
+    if (reclaimed > 0) {
+        printf("Reclaimed before finishing: %d jobs\n", reclaimed);
+    }
+    if (deadlines > 0) {
+        printf("Deadlines met: %d of %d\n", met, deadlines);
+    }
+}
 
-            /* unallocate resources */
-            for (i = 0; i < 4; i++) {
-                p->allocated_resources[i] = p->allocated_resources[i]
-                                            - resources[i];
-                available_matrix[i] = available_matrix[i] + resources[i];
-            }
+/* Function to sample the depths of the ready, wait and standby queues */
+void sample_queues(Simulation *s) {
 
-            /* rebuild matrices */
-            build_allocation_matrix();
-            build_max_need_matrix();
-            build_need_matrix();
+    int i;
+    int ready = 0;
+    int waiting = 0;
+    Process *p;
 
-            /* print info */
-            printf("Request of job No. %d for resources: %d %d %d %d "
-                   "cannot be satisfied\n",
-                    p->id, resources[0], resources[1],
-                    resources[2], resources[3]);
-            print_matrices();
+    TAILQ_FOREACH(p, &s->ready_queue, processes) {
+        ready++;
+    }
 
-            /* place in wait queue */
-            Process *temp_process = TAILQ_FIRST(&ready_queue);
-            TAILQ_REMOVE(&ready_queue, temp_process, processes);
-            TAILQ_INSERT_TAIL(&wait_queue, temp_process, processes);
+    TAILQ_FOREACH(p, &s->wait_queue, processes) {
+        waiting++;
+    }
 
-            return -1;
+    for (i = 0; i < num_resources; i++) {
+        TAILQ_FOREACH(p, &s->wait_lists[i], processes) {
+            waiting++;
         }
+    }
 
-     } else {
+    stats_sample(s->clock_time, ready, waiting,
+                 procs_count - s->next_job + s->standby_count);
+}
 
-         /* move to wait queue if resources are not available */
-         Process *temp_process = TAILQ_FIRST(&ready_queue);
-         TAILQ_REMOVE(&ready_queue, temp_process, processes);
-         TAILQ_INSERT_TAIL(&wait_queue, temp_process, processes);
-         return -1;
-     }
+/* Function to read the monotonic clock in nanoseconds */
+long now_ns() {
 
+    struct timespec now;
 
-    return 0;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
 }
 
-/* Function to release resrouces from a process */
-int release_resources(Process* p, int* resources) {
+/* Function to record how long a safety check started at start took */
+void record_latency(Simulation *s, long start) {
 
-    Process *temp_process;
+    s->safety_latencies = grow(s->safety_latencies, &s->latencies_capacity,
+                            s->latencies_count + 1, sizeof(long));
+    s->safety_latencies[s->latencies_count++] = now_ns() - start;
+}
 
-    /* if the process tried to release more resources than it has,
-     * terminate the process */
-    if (resources[0] <= p->allocated_resources[0] &&
-        resources[1] <= p->allocated_resources[1] &&
-        resources[2] <= p->allocated_resources[2] &&
-        resources[3] <= p->allocated_resources[3]) {
+/* Function to order latencies for the percentiles */
+int compare_latencies(const void *a, const void *b) {
 
-        /* release resouces */
-        available_matrix[0] = available_matrix[0] + resources[0];
-        available_matrix[1] = available_matrix[1] + resources[1];
-        available_matrix[2] = available_matrix[2] + resources[2];
-        available_matrix[3] = available_matrix[3] + resources[3];
+    long x = *(const long *) a;
+    long y = *(const long *) b;
 
-        p->allocated_resources[0] = p->allocated_resources[0] - resources[0];
-        p->allocated_resources[1] = p->allocated_resources[1] - resources[1];
-        p->allocated_resources[2] = p->allocated_resources[2] - resources[2];
-        p->allocated_resources[3] = p->allocated_resources[3] - resources[3];
+    return (x > y) - (x < y);
+}
 
+/* Function to print the parse throughput, request rate and safety check
+ * latency percentiles of the run */
+void print_benchmark(Simulation *s) {
 
-        /* rebuild allocation and need matrices */
-        build_allocation_matrix();
-        build_max_need_matrix();
-        build_need_matrix();
+    int i;
+    const int percentiles[] = {50, 90, 99};
 
-        /* check wait queue by moving the processes to the ready queue */
-        while (!TAILQ_EMPTY(&wait_queue)) {
+    printf("Parsed %ld bytes, %d jobs in %.3f ms (%.1f MB/s)\n",
+           input_bytes, procs_count, parse_ns / 1e6,
+           parse_ns > 0 ? input_bytes * 1e3 / parse_ns : 0.0);
+    printf("Ran %ld requests in %.3f ms (%.0f requests/s)\n",
+           s->requests_count, run_ns / 1e6,
+           run_ns > 0 ? s->requests_count * 1e9 / run_ns : 0.0);
 
-            temp_process  = TAILQ_FIRST(&wait_queue);
-            TAILQ_REMOVE(&wait_queue, temp_process, processes);
-            TAILQ_INSERT_TAIL(&ready_queue, temp_process, processes);
-        }
+    if (s->latencies_count == 0) {
+        return;
+    }
 
-        TAILQ_INIT(&wait_queue);
+    qsort(s->safety_latencies, s->latencies_count, sizeof(long),
+          compare_latencies);
 
-    } else {
+    printf("Safety checks: %d, latency", s->latencies_count);
+    for (i = 0; i < 3; i++) {
+        printf(" p%d %ld ns,", percentiles[i],
+               s->safety_latencies[(long) s->latencies_count * percentiles[i] /
+                                100]);
+    }
+    printf(" max %ld ns\n", s->safety_latencies[s->latencies_count - 1]);
+}
 
-        /* abnormally terminate the process */
-        terminate_process(p);
+/* Function to check if allocating resources to a process
+ * results in a safe state. The slots of the processes in the order
+ * they can finish are stored in sequence, unless it is NULL. Only the
+ * unfinished processes, tracked in a bitset, are looked at, and the
+ * search stops once all have finished or a pass finishes none. The
+ * matrices are read in place: the work vector and the bitset are the
+ * only state of the search */
+bool is_safe_state(Simulation *s, int *sequence) {
+
+    int j, w;
+    int words = BITSET_WORDS(s->ready_set_size);
+    int finished = 0;
+    bool progress = true;
+    uint64_t bits;
+    long start = STATS_START();
+
+    /* free slots are left out as already finished */
+    memcpy(s->unfinished, s->held_slots, words * sizeof(uint64_t));
+    memcpy(s->work, s->available_matrix,
+           s->need_matrix.stride * sizeof(int));
+
+    /* pass over the unfinished processes in slot order */
+    while (progress && finished < s->held_count) {
+
+        progress = false;
+        for (w = 0; w < words; w++) {
+            for (bits = s->unfinished[w]; bits != 0; bits &= bits - 1) {
+
+                j = w * 64 + __builtin_ctzll(bits);
+
+                /* compare whole padded rows, the padding is zero */
+                if (!vector_less_equal(MATRIX_ROW(s->need_matrix, j),
+                                       s->work, s->need_matrix.stride)) {
+                    continue;
+                }
 
-        /* check wait queue by moving the processes to the ready queue */
-        while (!TAILQ_EMPTY(&wait_queue)) {
+                /* release the resources, the process is not looked at
+                 * again once finished */
+                vector_add(s->work, MATRIX_ROW(s->allocation_matrix, j),
+                           s->need_matrix.stride);
 
-            temp_process  = TAILQ_FIRST(&wait_queue);
-            TAILQ_REMOVE(&wait_queue, temp_process, processes);
-            TAILQ_INSERT_TAIL(&ready_queue, temp_process, processes);
+                /* process is safe */
+                BITSET_CLEAR(s->unfinished, j);
+                if (sequence != NULL) {
+                    sequence[finished] = j;
+                }
+                finished++;
+                progress = true;
+            }
         }
+    }
 
-        /* reinitialize queue after emptying */
-        TAILQ_INIT(&wait_queue);
+    STATS_SAFETY_CHECK(start);
 
-        /* return -1, indicated error */
-        return -1;
+    /* return true if system is in a safe state, and false otherwise */
+    return finished == s->held_count;
+}
+
+/* Function to check if the state is safe the way the original
+ * simulation did, as the reference engine of --differential. The need
+ * and allocation matrices and the available resources are copied, and
+ * every slot is scanned element by element until a pass finishes no
+ * process. No cached sequence, bitset, vector kernel or undo log is
+ * used. The slots in the order they finish are stored in sequence,
+ * unless it is NULL */
+bool is_safe_reference(Simulation *s, int *sequence) {
+
+    int i, j, k;
+    int finished = 0;
+    int columns = num_resources;
+    bool fits;
+    bool progress = true;
+    bool *done;
+    int *work;
+    int *need;
+    int *allocation;
+    long start = STATS_START();
+
+    done = allocate(s->ready_set_size * sizeof(bool));
+    work = allocate(columns * sizeof(int));
+    need = allocate((size_t) s->ready_set_size * columns * sizeof(int));
+    allocation = allocate((size_t) s->ready_set_size * columns *
+                          sizeof(int));
+
+    for (i = 0; i < s->ready_set_size; i++) {
+
+        /* free slots are finished already */
+        done[i] = s->slot_processes[i] == NULL;
+
+        for (k = 0; k < columns; k++) {
+            need[i * columns + k] = MATRIX_ROW(s->max_need_matrix, i)[k] -
+                                    MATRIX_ROW(s->allocation_matrix, i)[k];
+            allocation[i * columns + k] =
+                MATRIX_ROW(s->allocation_matrix, i)[k];
+        }
     }
 
-    return 0;
-}
+    for (k = 0; k < columns; k++) {
+        work[k] = s->available_matrix[k];
+    }
 
-/* Function to check if allocating resources to a process
- * results in a safe state */
-bool is_safe_state() {
+    while (progress && finished < s->held_count) {
+
+        progress = false;
+        for (j = 0; j < s->ready_set_size; j++) {
+
+            if (done[j]) {
+                continue;
+            }
+
+            fits = true;
+            for (k = 0; k < columns; k++) {
+                if (need[j * columns + k] > work[k]) {
+                    fits = false;
+                }
+            }
 
-    int i, j, k, l;
-    bool is_safe[5] = {false, false, false, false, false};
+            if (!fits) {
+                continue;
+            }
 
-    /* local copies of matrices to test */
-    int copy_need[5][4];
-    int copy_allocation[5][4];
-    int copy_available[4];
+            for (k = 0; k < columns; k++) {
+                work[k] += allocation[j * columns + k];
+            }
 
-    /* copy matrices */
-    for (i = 0; i < 5; i++) {
-        for (j = 0; j < 4; j++) {
-            copy_need[i][j] = need_matrix[i][j];
-            copy_allocation[i][j] = allocation_matrix[i][j];
+            done[j] = true;
+            if (sequence != NULL) {
+                sequence[finished] = j;
+            }
+            finished++;
+            progress = true;
         }
     }
 
-    for (i = 0; i < 4; i++) {
-        copy_available[i] = available_matrix[i];
-    }
+    free(done);
+    free(work);
+    free(need);
+    free(allocation);
 
-    /* run loop 5 times */
-    for (i = 0; i < 5; i++) {
+    STATS_SAFETY_CHECK(start);
+
+    return finished == s->held_count;
+}
+
+/* Body of is_safe_state() for m resources. It is inlined into a function
+ * for each m up to SPECIALIZED_RESOURCES, where m is a constant, so the
+ * row loops are unrolled and the work vector is kept in registers. The
+ * need and allocation rows are read in place rather than copied */
+static inline __attribute__((always_inline))
+bool safe_state_unrolled(Simulation *s, int *sequence, const int m) {
+
+    int j, k, w;
+    int words = BITSET_WORDS(s->ready_set_size);
+    int finished = 0;
+    int work[SPECIALIZED_RESOURCES];
+    bool fits;
+    bool progress = true;
+    uint64_t bits;
+    const int *need;
+    const int *allocation;
+    long start = STATS_START();
+
+    #pragma GCC unroll 8
+    for (k = 0; k < m; k++) {
+        work[k] = s->available_matrix[k];
+    }
 
-        /* step through each process */
-        for (j = 0; j < 5; j++) {
+    /* free slots are left out as already finished */
+    memcpy(s->unfinished, s->held_slots, words * sizeof(uint64_t));
 
-            /* enter if process is not safe */
-            if (is_safe[j] == false) {
+    while (progress && finished < s->held_count) {
 
-                if (copy_need[j][0] <= copy_available[0] &&
-                    copy_need[j][1] <= copy_available[1] &&
-                    copy_need[j][2] <= copy_available[2] &&
-                    copy_need[j][3] <= copy_available[3]) {
+        progress = false;
+        for (w = 0; w < words; w++) {
+            for (bits = s->unfinished[w]; bits != 0; bits &= bits - 1) {
 
-                    /* release the resrouces */
-                    copy_available[0] = copy_available[0] +
-                                        copy_allocation[j][0];
+                j = w * 64 + __builtin_ctzll(bits);
+                need = MATRIX_ROW(s->need_matrix, j);
+                fits = true;
 
-                    copy_available[1] = copy_available[1] +
-                                        copy_allocation[j][1];
+                #pragma GCC unroll 8
+                for (k = 0; k < m; k++) {
+                    fits &= need[k] <= work[k];
+                }
 
-                    copy_available[2] = copy_available[2] +
-                                        copy_allocation[j][2];
+                if (!fits) {
+                    continue;
+                }
 
-                    copy_available[3] = copy_available[3] +
-                                        copy_allocation[j][3];
+                /* release the resources of the process */
+                allocation = MATRIX_ROW(s->allocation_matrix, j);
 
-                    /* set allocated resources to 0 */
-                    copy_allocation[j][0] = 0;
-                    copy_allocation[j][1] = 0;
-                    copy_allocation[j][2] = 0;
-                    copy_allocation[j][3] = 0;
+                #pragma GCC unroll 8
+                for (k = 0; k < m; k++) {
+                    work[k] += allocation[k];
+                }
 
-                    /* process is safe */
-                    is_safe[j] = true;
+                BITSET_CLEAR(s->unfinished, j);
+                if (sequence != NULL) {
+                    sequence[finished] = j;
                 }
+                finished++;
+                progress = true;
             }
         }
     }
 
-    /* return true if system is in a safe state, and false otherwise */
-    if (is_safe[0] == true && is_safe[1] == true &&
-        is_safe[2] == true && is_safe[3] == true &&
-        is_safe[4] == true) {
-        return true;
+    STATS_SAFETY_CHECK(start);
 
-    } else return false;
+    return finished == s->held_count;
 }
 
-/* Function to build the max_need_matrix using the ready_queue */
-int build_max_need_matrix() {
+/* Body of is_safe_prefix() for m resources, specialized like
+ * safe_state_unrolled() */
+static inline __attribute__((always_inline))
+bool safe_prefix_unrolled(Simulation *s, Process *p, const int *resources,
+                          const int m) {
+
+    int k;
+    int work[SPECIALIZED_RESOURCES];
+    bool fits;
+    const int *need;
+    Process *q;
+
+    #pragma GCC unroll 8
+    for (k = 0; k < m; k++) {
+        work[k] = s->available_matrix[k] - resources[k];
+    }
 
-    /* variables to store a process */
-    int i = 0;
-    int j;
-    Process *p;
+    TAILQ_FOREACH(q, &s->safe_queue, safe_processes) {
 
-    /* loop through the ready_queue to build the max_need_matrix */
-    TAILQ_FOREACH(p, &hold_queue, hold_processes) {
-        for(j = 0; j < 4; j++) {
-            max_need_matrix[i][j] = p->max_need[j];
+        if (q == p) {
+            return true;
         }
-        i++;
-    }
 
-    return 0;
-}
+        need = MATRIX_ROW(s->need_matrix, q->slot);
+        fits = true;
 
-/* Function to build the allocation_matrix using the ready_queue */
-int build_allocation_matrix() {
+        #pragma GCC unroll 8
+        for (k = 0; k < m; k++) {
+            fits &= need[k] <= work[k];
+        }
 
-    /* variables to store a process */
-    int i = 0;
-    int j;
-    Process *p;
+        if (!fits) {
+            return false;
+        }
 
-    /* loop through the ready_queue to build the allocation_matrix */
-    TAILQ_FOREACH(p, &hold_queue, hold_processes) {
-        for(j = 0; j < 4; j++) {
-            allocation_matrix[i][j] = p->allocated_resources[j];
+        #pragma GCC unroll 8
+        for (k = 0; k < m; k++) {
+            work[k] += q->allocated_resources[k];
         }
-        i++;
     }
 
-    return 0;
+    return false;
 }
 
-/* Function to build the need_matrix using the ready_queue */
-int build_need_matrix() {
-
-    /* variables to store a process */
-    int i = 0;
-    int j;
-    Process *p;
+/* Macro to define the safety checks specialized for m resources */
+#define SPECIALIZE_SAFETY_CHECKS(m)                                       \
+    static bool is_safe_state_##m(Simulation *s, int *sequence) {        \
+        return safe_state_unrolled(s, sequence, m);                       \
+    }                                                                     \
+    static bool is_safe_prefix_##m(Simulation *s, Process *p,            \
+                                   const int *resources) {               \
+        return safe_prefix_unrolled(s, p, resources, m);                  \
+    }
 
-    /* loop through the ready_queue to build the need_matrix */
-    TAILQ_FOREACH(p, &hold_queue, hold_processes) {
-        for(j = 0; j < 4; j++) {
-            need_matrix[i][j] = max_need_matrix[i][j] - allocation_matrix[i][j];
-        }
-        i++;
+SPECIALIZE_SAFETY_CHECKS(1)
+SPECIALIZE_SAFETY_CHECKS(2)
+SPECIALIZE_SAFETY_CHECKS(3)
+SPECIALIZE_SAFETY_CHECKS(4)
+SPECIALIZE_SAFETY_CHECKS(5)
+SPECIALIZE_SAFETY_CHECKS(6)
+SPECIALIZE_SAFETY_CHECKS(7)
+SPECIALIZE_SAFETY_CHECKS(8)
+
+/* Function to select the safety checks specialized for num_resources,
+ * or the generic ones if there are more resources than
+ * SPECIALIZED_RESOURCES or --generic is given */
+void select_safety_checks() {
+
+    static bool (*const state_checks[])(Simulation *, int *) = {
+        is_safe_state, is_safe_state_1, is_safe_state_2, is_safe_state_3,
+        is_safe_state_4, is_safe_state_5, is_safe_state_6, is_safe_state_7,
+        is_safe_state_8
+    };
+    static bool (*const prefix_checks[])(Simulation *, Process *,
+                                         const int *) = {
+        is_safe_prefix, is_safe_prefix_1, is_safe_prefix_2,
+        is_safe_prefix_3, is_safe_prefix_4, is_safe_prefix_5,
+        is_safe_prefix_6, is_safe_prefix_7, is_safe_prefix_8
+    };
+
+    if (generic_checks || num_resources > SPECIALIZED_RESOURCES) {
+        safe_state_check = is_safe_state;
+        safe_prefix_check = is_safe_prefix;
+        return;
     }
 
-    return 0;
+    safe_state_check = state_checks[num_resources];
+    safe_prefix_check = prefix_checks[num_resources];
 }
 
-/* Function to print the relevant matrices */
-void print_matrices() {
+/* Function to print the relevant matrices. The rows of the held
+ * processes are printed in the order they were admitted, followed by
+ * empty rows for the rest of the ready set */
+void print_matrices(Simulation *s) {
 
 
-    int i, j, k;
+    int i;
     printf("\n");
 
     /* print available matrix */
     printf("Available Matrix:\n");
-    for (i = 0; i < 4; i++) {
-        printf("%d ", available_matrix[i]);
+    for (i = 0; i < num_resources; i++) {
+        printf("%d ", s->available_matrix[i]);
     }
 
     /* print allocation matrix */
     printf("\n\nAllocation Matrix:");
-    for (i = 0; i < 5; i++) {
-        printf("\n");
-        for (j = 0; j < 4; j++) {
-            printf("%d ", allocation_matrix[i][j]);
-        }
-    }
+    print_matrix(s, &s->allocation_matrix);
 
     /* print max need matrix */
     printf("\n\nMax Need Matrix:");
-    for (i = 0; i < 5; i++) {
-        printf("\n");
-        for (j = 0; j < 4; j++) {
-            printf("%d ", max_need_matrix[i][j]);
-        }
-    }
+    print_matrix(s, &s->max_need_matrix);
 
     /* print need matrix */
     printf("\n\nNeed Matrix:");
-    for (i = 0; i < 5; i++) {
+    print_matrix(s, &s->need_matrix);
+
+    printf("\n----------------------------------"
+           "-------------------------------\n");
+}
+
+/* Function to print the rows of a matrix in admission order */
+void print_matrix(Simulation *s, Matrix *m) {
+
+    int i, j;
+    Process *p;
+
+    TAILQ_FOREACH(p, &s->hold_queue, hold_processes) {
         printf("\n");
-        for (j = 0; j < 4; j++) {
-            printf("%d ", need_matrix[i][j]);
+        for (j = 0; j < num_resources; j++) {
+            printf("%d ", MATRIX_ROW(*m, p->slot)[j]);
         }
     }
 
-    printf("\n----------------------------------"
-           "-------------------------------\n");
+    for (i = s->held_count; i < s->ready_set_size; i++) {
+        printf("\n");
+        for (j = 0; j < num_resources; j++) {
+            printf("0 ");
+        }
+    }
 }
@@ -0,0 +1,241 @@
+/**
+ * Stream of the grant, deny and terminate decisions of a simulation. A
+ * stream is recorded from one run and another run of the same workload
+ * is checked against it, reporting the first decision that differs
+ **/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decision_stream.h"
+
+/* Stream file format. The header is followed by the decisions, stored
+ * in host byte order like the traces */
+#define STREAM_MAGIC "BNKR"
+#define STREAM_VERSION 1
+#define STREAM_BYTE_ORDER 0x01020304
+
+typedef struct StreamHeader {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+} StreamHeader;
+
+typedef struct Decision {
+    int64_t tick;
+    int32_t job;
+    int32_t type;
+} Decision;
+
+static const char *decision_names[] = {"ADMIT", "GRANT", "UNAVAILABLE",
+                                       "UNSAFE", "RELEASE", "SLEEP",
+                                       "TERMINATE"};
+
+bool decisions_enabled = false;
+
+static Decision *stream;
+static long stream_count;
+static long stream_capacity;
+static long position;
+static bool replaying;
+static bool diverged;
+static const char *stream_path;
+
+/* Function to start recording decisions */
+int decisions_record(const char *path) {
+
+    decisions_free();
+    stream_path = path;
+    replaying = false;
+    decisions_enabled = true;
+    return 0;
+}
+
+/* Function to start checking decisions against a stream */
+int decisions_replay(const char *path) {
+
+    FILE *file;
+    StreamHeader header;
+
+    if (path != NULL) {
+
+        decisions_free();
+
+        file = fopen(path, "rb");
+        if (file == NULL) {
+            perror(path);
+            return -1;
+        }
+
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            memcmp(header.magic, STREAM_MAGIC, 4) != 0 ||
+            header.byte_order != STREAM_BYTE_ORDER ||
+            header.version != STREAM_VERSION) {
+            printf("%s is not a decision stream\n", path);
+            fclose(file);
+            return -1;
+        }
+
+        stream_count = header.count;
+        stream_capacity = header.count;
+        stream = malloc((header.count > 0 ? header.count : 1) *
+                        sizeof(Decision));
+        if (stream == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+
+        if (fread(stream, sizeof(Decision), header.count, file) !=
+            header.count) {
+            printf("%s is truncated\n", path);
+            fclose(file);
+            return -1;
+        }
+
+        fclose(file);
+
+        for (position = 0; position < stream_count; position++) {
+            if (stream[position].type < TRACE_GRANT ||
+                stream[position].type > TRACE_TERMINATE) {
+                printf("%s has a corrupt decision\n", path);
+                return -1;
+            }
+        }
+    }
+
+    position = 0;
+    diverged = false;
+    replaying = true;
+    decisions_enabled = true;
+    return 0;
+}
+
+/* Function to record a decision, or check it against the stream */
+void decision_event(TraceType type, int job, long tick) {
+
+    Decision *d;
+
+    if (type != TRACE_GRANT && type != TRACE_DENY_UNAVAILABLE &&
+        type != TRACE_DENY_UNSAFE && type != TRACE_TERMINATE) {
+        return;
+    }
+
+    if (!replaying) {
+
+        if (stream_count == stream_capacity) {
+            stream_capacity = stream_capacity == 0 ? 4096 :
+                              stream_capacity * 2;
+            stream = realloc(stream, stream_capacity * sizeof(Decision));
+            if (stream == NULL) {
+                printf("Out of memory\n");
+                exit(1);
+            }
+        }
+
+        d = &stream[stream_count++];
+        d->tick = tick;
+        d->job = job;
+        d->type = type;
+        return;
+    }
+
+    /* only the first difference is reported, the rest follow from it */
+    if (diverged) {
+        return;
+    }
+
+    if (position == stream_count) {
+
+        printf("First difference at decision %ld, tick %ld: the reference "
+               "made no more decisions, this run made %s of job No. %d\n",
+               position, tick, decision_names[type], job);
+        diverged = true;
+        return;
+    }
+
+    d = &stream[position];
+    if (d->tick != tick || d->job != job || d->type != (int32_t) type) {
+
+        printf("First difference at decision %ld: the reference made %s "
+               "of job No. %d at tick %ld, this run made %s of job No. %d "
+               "at tick %ld\n", position, decision_names[d->type], d->job,
+               (long) d->tick, decision_names[type], job, tick);
+        diverged = true;
+        return;
+    }
+
+    position++;
+}
+
+/* Function to stop recording or checking */
+int decisions_close(void) {
+
+    int status = 0;
+    FILE *file;
+    StreamHeader header;
+
+    if (!decisions_enabled) {
+        return 0;
+    }
+
+    decisions_enabled = false;
+
+    if (replaying) {
+
+        if (!diverged && position < stream_count) {
+            printf("First difference at decision %ld: the reference made "
+                   "%s of job No. %d at tick %ld, this run made no more "
+                   "decisions\n", position,
+                   decision_names[stream[position].type],
+                   stream[position].job, (long) stream[position].tick);
+            diverged = true;
+        }
+
+        if (!diverged) {
+            printf("All %ld decisions match the reference\n", stream_count);
+        }
+
+        return diverged ? -1 : 0;
+    }
+
+    if (stream_path == NULL) {
+        return 0;
+    }
+
+    file = fopen(stream_path, "wb");
+    if (file == NULL) {
+        perror(stream_path);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STREAM_MAGIC, 4);
+    header.byte_order = STREAM_BYTE_ORDER;
+    header.version = STREAM_VERSION;
+    header.count = stream_count;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(stream, sizeof(Decision), stream_count, file) !=
+        (size_t) stream_count) {
+        status = -1;
+    }
+
+    if (fclose(file) != 0 || status == -1) {
+        perror(stream_path);
+        status = -1;
+    }
+
+    return status;
+}
+
+/* Function to free the stream kept in memory */
+void decisions_free(void) {
+
+    free(stream);
+    stream = NULL;
+    stream_count = 0;
+    stream_capacity = 0;
+}
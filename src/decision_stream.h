@@ -0,0 +1,45 @@
+/**
+ * Stream of the grant, deny and terminate decisions of a simulation. A
+ * stream is recorded from one run and another run of the same workload
+ * is checked against it, reporting the first decision that differs
+ **/
+
+#ifndef DECISION_STREAM_H
+#define DECISION_STREAM_H
+
+#include <stdbool.h>
+#include "event_trace.h"
+
+/* true while decisions are recorded or checked */
+extern bool decisions_enabled;
+
+/* Function to start recording decisions. They are kept in memory to be
+ * checked against by decisions_replay(NULL), and written to path by
+ * decisions_close() unless path is NULL */
+int decisions_record(const char *path);
+
+/* Function to start checking decisions against the stream recorded in
+ * path, or in memory if path is NULL. Returns -1 if the stream cannot
+ * be read */
+int decisions_replay(const char *path);
+
+/* Function to record or check the decision of type about a job at the
+ * given tick. Only grants, denials and terminations are decisions */
+void decision_event(TraceType type, int job, long tick);
+
+/* Function to stop recording or checking. A recorded stream is written
+ * out, and a checked one is reported on. Returns -1 if the stream could
+ * not be written or the decisions differ */
+int decisions_close(void);
+
+/* Function to free the stream kept in memory */
+void decisions_free(void);
+
+#define DECISION_EVENT(type, job, tick)                              \
+    do {                                                             \
+        if (decisions_enabled) {                                     \
+            decision_event((type), (job), (tick));                   \
+        }                                                            \
+    } while (0)
+
+#endif
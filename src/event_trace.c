@@ -0,0 +1,397 @@
+/**
+ * Binary event trace of the simulation. Events are recorded in a ring
+ * buffer that is flushed to the trace file when full, and a trace is
+ * decoded offline into the matrix snapshots of the unsafe requests.
+ * Building with -DNO_EVENT_TRACE compiles the recording out
+ **/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "event_trace.h"
+
+/* Trace file format. The header and the totals are followed by fixed
+ * width records, stored in host byte order like the binary workloads */
+#define TRACE_MAGIC "BNKT"
+#define TRACE_VERSION 1
+#define TRACE_BYTE_ORDER 0x01020304
+
+/* Number of records buffered before they are written out */
+#define TRACE_BUFFER_EVENTS 4096
+
+typedef struct TraceHeader {
+    char magic[4];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t num_resources;
+    uint32_t ready_set_size;
+    uint32_t record_size;
+} TraceHeader;
+
+/* A record holds num_resources values, padded to a multiple of 8 bytes */
+typedef struct TraceRecord {
+    int64_t time;
+    int64_t tick;
+    int32_t type;
+    int32_t job;
+    int32_t slot;
+    int32_t reserved;
+    int32_t values[];
+} TraceRecord;
+
+/* Matrices rebuilt by the decoder */
+typedef enum TraceMatrix {
+    TRACE_ALLOCATION,
+    TRACE_MAX_NEED,
+    TRACE_NEED
+} TraceMatrix;
+
+/* Held job rebuilt by the decoder */
+typedef struct TraceSlot {
+    int job;
+    int *max_need;
+    int *allocation;
+} TraceSlot;
+
+static const char *trace_names[] = {"ADMIT", "GRANT", "UNAVAILABLE",
+                                    "UNSAFE", "RELEASE", "SLEEP",
+                                    "TERMINATE"};
+
+bool trace_enabled = false;
+
+#ifdef NO_EVENT_TRACE
+
+/* Recording is compiled out, only decoding is left */
+int trace_open(const char *path, int num_resources, const int *total,
+               int ready_set_size) {
+
+    (void) path;
+    (void) num_resources;
+    (void) total;
+    (void) ready_set_size;
+
+    printf("Event tracing was compiled out\n");
+    return -1;
+}
+
+void trace_event(TraceType type, int job, int slot, long tick,
+                 const int *values) {
+
+    (void) type;
+    (void) job;
+    (void) slot;
+    (void) tick;
+    (void) values;
+}
+
+int trace_close(void) {
+
+    return 0;
+}
+
+#else
+
+static FILE *trace_file;
+static char *ring;
+static size_t ring_used;
+static size_t record_size;
+static int trace_resources;
+
+/* Function to write out the buffered records */
+static int flush_ring(void) {
+
+    if (ring_used > 0 && fwrite(ring, ring_used, 1, trace_file) != 1) {
+        return -1;
+    }
+
+    ring_used = 0;
+    return 0;
+}
+
+/* Function to start tracing to path */
+int trace_open(const char *path, int num_resources, const int *total,
+               int ready_set_size) {
+
+    TraceHeader header;
+
+    trace_file = fopen(path, "wb");
+    if (trace_file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    trace_resources = num_resources;
+    record_size = (sizeof(TraceRecord) + num_resources * sizeof(int32_t) +
+                   7) & ~(size_t) 7;
+    ring = calloc(TRACE_BUFFER_EVENTS, record_size);
+    ring_used = 0;
+    if (ring == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.byte_order = TRACE_BYTE_ORDER;
+    header.version = TRACE_VERSION;
+    header.num_resources = num_resources;
+    header.ready_set_size = ready_set_size;
+    header.record_size = record_size;
+
+    fwrite(&header, sizeof(header), 1, trace_file);
+    fwrite(total, sizeof(int32_t), num_resources, trace_file);
+
+    trace_enabled = true;
+    return 0;
+}
+
+/* Function to record an event */
+void trace_event(TraceType type, int job, int slot, long tick,
+                 const int *values) {
+
+    struct timespec now;
+    TraceRecord *record;
+
+    if (ring_used + record_size > TRACE_BUFFER_EVENTS * record_size) {
+        flush_ring();
+    }
+
+    record = (TraceRecord *) (ring + ring_used);
+    ring_used += record_size;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->time = now.tv_sec * 1000000000LL + now.tv_nsec;
+    record->tick = tick;
+    record->type = type;
+    record->job = job;
+    record->slot = slot;
+    memcpy(record->values, values, trace_resources * sizeof(int32_t));
+}
+
+/* Function to flush and close the trace */
+int trace_close(void) {
+
+    int status;
+
+    if (!trace_enabled) {
+        return 0;
+    }
+
+    status = flush_ring();
+    if (fclose(trace_file) != 0) {
+        status = -1;
+    }
+
+    free(ring);
+    trace_enabled = false;
+    return status;
+}
+
+#endif
+
+/* Function to print a matrix of the held jobs in admission order, with
+ * empty rows for the rest of the ready set, as print_matrices() does */
+static void print_rows(TraceSlot *slots, int *order, int held, int rows,
+                       int columns, TraceMatrix matrix) {
+
+    int i, j;
+    int value;
+    TraceSlot *s;
+
+    for (i = 0; i < rows; i++) {
+
+        printf("\n");
+        for (j = 0; j < columns; j++) {
+
+            value = 0;
+            if (i < held) {
+                s = &slots[order[i]];
+                value = matrix == TRACE_ALLOCATION ? s->allocation[j] :
+                        matrix == TRACE_MAX_NEED ? s->max_need[j] :
+                        s->max_need[j] - s->allocation[j];
+            }
+            printf("%d ", value);
+        }
+    }
+}
+
+/* Function to print the snapshot of an unsafe request */
+static void print_snapshot(TraceRecord *record, TraceSlot *slots,
+                           int *order, int held, int *available,
+                           int rows, int columns) {
+
+    int i;
+
+    printf("Request of job No. %d for resources:", record->job);
+    for (i = 0; i < columns; i++) {
+        printf(" %d", record->values[i]);
+    }
+    printf(" cannot be satisfied\n");
+
+    printf("\nAvailable Matrix:\n");
+    for (i = 0; i < columns; i++) {
+        printf("%d ", available[i]);
+    }
+
+    printf("\n\nAllocation Matrix:");
+    print_rows(slots, order, held, rows, columns, TRACE_ALLOCATION);
+
+    printf("\n\nMax Need Matrix:");
+    print_rows(slots, order, held, rows, columns, TRACE_MAX_NEED);
+
+    printf("\n\nNeed Matrix:");
+    print_rows(slots, order, held, rows, columns, TRACE_NEED);
+
+    printf("\n----------------------------------"
+           "-------------------------------\n");
+}
+
+/* Function to decode a trace */
+int trace_decode(const char *path, bool events) {
+
+    int i;
+    int held = 0;
+    int status = 0;
+    int64_t first_time = -1;
+    int *total;
+    int *available;
+    int *order;
+    int *values;
+    FILE *file;
+    TraceHeader header;
+    TraceRecord *record;
+    TraceSlot *slots;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, 4) != 0 ||
+        header.byte_order != TRACE_BYTE_ORDER ||
+        header.version != TRACE_VERSION || header.num_resources == 0 ||
+        header.ready_set_size == 0 ||
+        header.record_size < sizeof(TraceRecord) +
+                             header.num_resources * sizeof(int32_t)) {
+        printf("%s is not a trace\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    total = calloc(header.num_resources, sizeof(int));
+    available = calloc(header.num_resources, sizeof(int));
+    order = calloc(header.ready_set_size, sizeof(int));
+    slots = calloc(header.ready_set_size, sizeof(TraceSlot));
+    values = calloc((size_t) header.ready_set_size * 2 *
+                    header.num_resources, sizeof(int));
+    record = malloc(header.record_size);
+    if (total == NULL || available == NULL || order == NULL ||
+        slots == NULL || values == NULL || record == NULL) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    if (fread(total, sizeof(int32_t), header.num_resources, file) !=
+        header.num_resources) {
+        printf("%s is truncated\n", path);
+        status = -1;
+    }
+    memcpy(available, total, header.num_resources * sizeof(int));
+
+    for (i = 0; i < (int) header.ready_set_size; i++) {
+        slots[i].max_need = values + (size_t) i * 2 * header.num_resources;
+        slots[i].allocation = slots[i].max_need + header.num_resources;
+    }
+
+    while (status == 0 && fread(record, header.record_size, 1, file) == 1) {
+
+        if (record->slot < 0 ||
+            record->slot >= (int) header.ready_set_size ||
+            record->type < TRACE_ADMIT || record->type > TRACE_TERMINATE) {
+            printf("%s has a corrupt record\n", path);
+            status = -1;
+            break;
+        }
+
+        if (events) {
+
+            if (first_time == -1) {
+                first_time = record->time;
+            }
+
+            printf("%ld\t%.3f ms\t%-11s\tjob %d\tslot %d\t",
+                   (long) record->tick, (record->time - first_time) / 1e6,
+                   trace_names[record->type], record->job, record->slot);
+            for (i = 0; i < (int) header.num_resources; i++) {
+                printf(" %d", record->values[i]);
+            }
+            printf("\n");
+        }
+
+        switch (record->type) {
+
+            case TRACE_ADMIT:
+                if (held == (int) header.ready_set_size) {
+                    printf("%s admits past the ready set\n", path);
+                    status = -1;
+                    break;
+                }
+                slots[record->slot].job = record->job;
+                memcpy(slots[record->slot].max_need, record->values,
+                       header.num_resources * sizeof(int));
+                memset(slots[record->slot].allocation, 0,
+                       header.num_resources * sizeof(int));
+                order[held++] = record->slot;
+                break;
+
+            case TRACE_GRANT:
+                for (i = 0; i < (int) header.num_resources; i++) {
+                    slots[record->slot].allocation[i] += record->values[i];
+                    available[i] -= record->values[i];
+                }
+                break;
+
+            case TRACE_RELEASE:
+            case TRACE_TERMINATE:
+                for (i = 0; i < (int) header.num_resources; i++) {
+                    slots[record->slot].allocation[i] -= record->values[i];
+                    available[i] += record->values[i];
+                }
+
+                /* the job leaves the ready set */
+                if (record->type == TRACE_TERMINATE) {
+                    for (i = 0; i < held && order[i] != record->slot; i++);
+                    if (i < held) {
+                        memmove(order + i, order + i + 1,
+                                (held - i - 1) * sizeof(int));
+                        held--;
+                    }
+                }
+                break;
+
+            case TRACE_DENY_UNSAFE:
+                if (!events) {
+                    print_snapshot(record, slots, order, held, available,
+                                   header.ready_set_size,
+                                   header.num_resources);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    fclose(file);
+    free(total);
+    free(available);
+    free(order);
+    free(slots);
+    free(values);
+    free(record);
+    return status;
+}
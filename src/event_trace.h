@@ -0,0 +1,59 @@
+/**
+ * Binary event trace of the simulation. Events are recorded in a ring
+ * buffer that is flushed to the trace file when full, and a trace is
+ * decoded offline into the matrix snapshots of the unsafe requests.
+ * Building with -DNO_EVENT_TRACE compiles the recording out
+ **/
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stdbool.h>
+
+/* Events recorded. The values of an event are the max need for ADMIT,
+ * the request for GRANT and the denials, the resources released for
+ * RELEASE and TERMINATE, and the SL operand for SLEEP */
+typedef enum TraceType {
+    TRACE_ADMIT = 0,
+    TRACE_GRANT,
+    TRACE_DENY_UNAVAILABLE,
+    TRACE_DENY_UNSAFE,
+    TRACE_RELEASE,
+    TRACE_SLEEP,
+    TRACE_TERMINATE
+} TraceType;
+
+/* true between trace_open() and trace_close() */
+extern bool trace_enabled;
+
+/* Function to start tracing to path. The dimensions and totals are
+ * stored in the header of the trace. Returns -1 if the file cannot be
+ * created or tracing was compiled out */
+int trace_open(const char *path, int num_resources, const int *total,
+               int ready_set_size);
+
+/* Function to record an event of a job held in the given matrix slot at
+ * the given tick of the simulated clock */
+void trace_event(TraceType type, int job, int slot, long tick,
+                 const int *values);
+
+/* Function to flush the ring buffer and close the trace */
+int trace_close(void);
+
+/* Function to decode a trace. The snapshot printed by print_matrices()
+ * is rebuilt for every unsafe request, or every event is listed with
+ * its timestamps if events is true */
+int trace_decode(const char *path, bool events);
+
+#ifdef NO_EVENT_TRACE
+#define TRACE_EVENT(type, job, slot, tick, values) ((void) 0)
+#else
+#define TRACE_EVENT(type, job, slot, tick, values)                   \
+    do {                                                             \
+        if (trace_enabled) {                                         \
+            trace_event((type), (job), (slot), (tick), (values));    \
+        }                                                            \
+    } while (0)
+#endif
+
+#endif
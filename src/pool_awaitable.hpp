@@ -0,0 +1,61 @@
+/**
+ * Awaitable adapter for the asynchronous requests of the pool manager,
+ * for C++20 coroutines. co_await on a PmRequest makes the request with
+ * pm_request_async() and resumes the coroutine with its status: at once
+ * if it is decided at once, otherwise on the thread whose release or
+ * exit completes it
+ *
+ *     RmStatus status = co_await PmRequest(pm, pid, resources);
+ **/
+
+#ifndef POOL_AWAITABLE_HPP
+#define POOL_AWAITABLE_HPP
+
+#include <atomic>
+#include <coroutine>
+
+extern "C" {
+#include "pool_manager.h"
+}
+
+class PmRequest {
+public:
+    PmRequest(PoolManager *pm, int pid, const int *resources)
+        : pm(pm), pid(pid), resources(resources) {}
+
+    PmRequest(const PmRequest &) = delete;
+    PmRequest &operator=(const PmRequest &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    /* the callback and the awaiting thread race to finish second: the
+     * one that does resumes, so a request decided at once never
+     * suspends */
+    bool await_suspend(std::coroutine_handle<> handle) {
+        awaiting = handle;
+        pm_request_async(pm, pid, resources, complete, this);
+        return !decided.exchange(true);
+    }
+
+    RmStatus await_resume() const noexcept { return status; }
+
+private:
+    /* Function called by the manager once the request is decided */
+    static void complete(int, RmStatus status, void *context) {
+        PmRequest *request = static_cast<PmRequest *>(context);
+
+        request->status = status;
+        if (request->decided.exchange(true)) {
+            request->awaiting.resume();
+        }
+    }
+
+    PoolManager *pm;
+    int pid;
+    const int *resources;
+    RmStatus status = RM_INVALID;
+    std::atomic<bool> decided{false};
+    std::coroutine_handle<> awaiting;
+};
+
+#endif
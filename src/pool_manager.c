@@ -0,0 +1,875 @@
+/**
+ * Resource manager sharded into pools of resources. Each pool runs the
+ * Banker's algorithm over its own group of resources with its own state,
+ * lock and safety check, so calls decided by different pools never
+ * contend. A request for resources of several pools is granted by an
+ * ordered two phase grant across them.
+ *
+ * A process needing the resources of one pool only is local to it. A
+ * process needing those of several pools is shared by them, and every
+ * pool finishes its shared processes in the order they were registered.
+ * The safe sequences of the pools then merge into one safe sequence of
+ * the whole system: the local processes of each pool only depend on that
+ * pool, and a shared process finishes after the same shared processes in
+ * every pool. Shared processes are registered one at a time so that the
+ * order is the same in every pool.
+ *
+ * A request spanning several pools is prepared in each of them in pool
+ * order, keeping each pool locked, and is committed once every pool has
+ * granted it or rolled back in reverse order as soon as one denies it.
+ * Taking the pools in the same order keeps the threads from deadlocking.
+ *
+ * An asynchronous request that cannot be granted is kept pending on a
+ * list of the manager: the list of the first resource it is short on, or
+ * the list of its pool if it was denied as unsafe. Every release and exit
+ * bumps an atomic release count and, only if something is pending, takes
+ * the pending lock and retries the lists of the resources and pools it
+ * returned resources to, oldest first. The thread that released calls the
+ * callbacks of the requests granted once the lists are unlocked. A
+ * request counts itself pending before it reads the release count again,
+ * and a release bumps the count before it reads the pending count, so
+ * either the request sees the release and is retried at once or the
+ * release sees the request on its list.
+ **/
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pool_manager.h"
+#include "vector_kernels.h"
+
+/* Rows are padded to a cache line so that the threads working for
+ * different processes do not share lines */
+#define CACHE_LINE 64
+
+/* Macro to round a row of count elements of size bytes up to lines */
+#define LINE_ROUND(count, size) \
+    (((count) * (size) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE / (size))
+
+/* A pool and where its resources are in a split row */
+typedef struct Pool {
+    ResourceManager *rm;
+    int offset;
+    int size;
+} Pool;
+
+struct PoolManager {
+    int num_resources;
+    int num_pools;
+    int capacity;
+    int stride;
+    int member_stride;
+    Pool *pools;
+    int *position;
+    int *home;
+    int *span;
+    int *split;
+    int *held;
+    bool *member;
+    bool *active;
+    pthread_mutex_t register_lock;
+    pthread_mutex_t pending_lock;
+    int num_lists;
+    int *list_head;
+    int *list_tail;
+    int *request;
+    int *available;
+    int *next_pending;
+    int *previous_pending;
+    int *pending_list;
+    bool *pending;
+    PmCallback *done;
+    void **context;
+    RmStatus *last_status;
+    _Atomic int pending_count;
+    _Atomic int registered;
+    _Atomic long releases;
+    long pending_total;
+    long stalled_total;
+    long retries;
+    _Atomic long shared;
+    _Atomic long cross_grants;
+    _Atomic long cross_denials;
+};
+
+/* Macro to address the row of a process */
+#define ROW(pm, matrix, pid, stride) \
+    ((pm)->matrix + (size_t) (pid) * (pm)->stride)
+
+/* Function to check that a vector has no negative values */
+static bool non_negative(PoolManager *pm, const int *values) {
+
+    int i;
+
+    for (i = 0; i < pm->num_resources; i++) {
+        if (values[i] < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Function to check that the part of a split row in pool p is zero */
+static bool is_zero(PoolManager *pm, const int *split, int p) {
+
+    int i;
+
+    for (i = 0; i < pm->pools[p].size; i++) {
+        if (split[pm->pools[p].offset + i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Function to split a vector into the parts of the pools, stored one
+ * after the other in the split row of pid. Returns the row */
+static int *split_row(PoolManager *pm, int pid, const int *values) {
+
+    int i;
+    int *split = ROW(pm, split, pid, stride);
+
+    for (i = 0; i < pm->num_resources; i++) {
+        split[pm->position[i]] = values[i];
+    }
+
+    return split;
+}
+
+/* Function to check that a split row only has resources of the pools pid
+ * joined, counting the pools it has resources of */
+static bool check_pools(PoolManager *pm, int pid, const int *split,
+                        int *touched) {
+
+    int p;
+    bool *member = ROW(pm, member, pid, member_stride);
+
+    *touched = 0;
+
+    for (p = 0; p < pm->num_pools; p++) {
+
+        if (!is_zero(pm, split, p)) {
+
+            if (!member[p]) {
+                return false;
+            }
+            (*touched)++;
+        }
+    }
+
+    return true;
+}
+
+PoolManager *pm_create(int num_resources, const int *total, int capacity,
+                       int num_pools, const int *pool_of) {
+
+    int i;
+    int p;
+    int *part;
+    PoolManager *pm;
+
+    if (num_resources <= 0 || capacity <= 0 || num_pools <= 0) {
+        return NULL;
+    }
+
+    pm = calloc(1, sizeof(PoolManager));
+    if (pm == NULL) {
+        return NULL;
+    }
+
+    pm->num_resources = num_resources;
+    pm->num_pools = num_pools;
+    pm->capacity = capacity;
+    pm->stride = LINE_ROUND(num_resources, sizeof(int));
+    pm->member_stride = LINE_ROUND(num_pools, sizeof(bool));
+    pm->num_lists = num_resources + num_pools;
+    pthread_mutex_init(&pm->register_lock, NULL);
+    pthread_mutex_init(&pm->pending_lock, NULL);
+
+    pm->pools = calloc(num_pools, sizeof(Pool));
+    pm->position = calloc(num_resources, sizeof(int));
+    pm->home = calloc(capacity, sizeof(int));
+    pm->span = calloc(capacity, sizeof(int));
+    pm->split = calloc((size_t) capacity * pm->stride, sizeof(int));
+    pm->held = calloc((size_t) capacity * pm->stride, sizeof(int));
+    pm->member = calloc((size_t) capacity * pm->member_stride, sizeof(bool));
+    pm->active = calloc(capacity, sizeof(bool));
+    pm->list_head = malloc(pm->num_lists * sizeof(int));
+    pm->list_tail = malloc(pm->num_lists * sizeof(int));
+    pm->request = calloc((size_t) capacity * pm->stride, sizeof(int));
+    pm->available = calloc((size_t) capacity * pm->stride, sizeof(int));
+    pm->next_pending = calloc(capacity, sizeof(int));
+    pm->previous_pending = calloc(capacity, sizeof(int));
+    pm->pending_list = calloc(capacity, sizeof(int));
+    pm->pending = calloc(capacity, sizeof(bool));
+    pm->done = calloc(capacity, sizeof(PmCallback));
+    pm->context = calloc(capacity, sizeof(void *));
+    pm->last_status = calloc(capacity, sizeof(RmStatus));
+    part = calloc(num_resources, sizeof(int));
+
+    if (pm->pools == NULL || pm->position == NULL || pm->home == NULL ||
+        pm->span == NULL || pm->split == NULL || pm->held == NULL ||
+        pm->member == NULL || pm->active == NULL || pm->list_head == NULL ||
+        pm->list_tail == NULL || pm->request == NULL ||
+        pm->available == NULL || pm->next_pending == NULL ||
+        pm->previous_pending == NULL || pm->pending_list == NULL ||
+        pm->pending == NULL ||
+        pm->done == NULL || pm->context == NULL ||
+        pm->last_status == NULL || part == NULL) {
+        free(part);
+        pm_destroy(pm);
+        return NULL;
+    }
+
+    for (i = 0; i < pm->num_lists; i++) {
+        pm->list_head[i] = -1;
+        pm->list_tail[i] = -1;
+    }
+
+    /* size the pools and place their resources one pool after another */
+    for (i = 0; i < num_resources; i++) {
+        pm->pools[pool_of[i]].size++;
+    }
+
+    for (p = 1; p < num_pools; p++) {
+        pm->pools[p].offset = pm->pools[p - 1].offset + pm->pools[p - 1].size;
+    }
+
+    for (i = 0; i < num_resources; i++) {
+        pm->position[i] = pm->pools[pool_of[i]].offset + part[pool_of[i]]++;
+    }
+
+    /* every pool manages the totals of its own resources */
+    for (i = 0; i < num_resources; i++) {
+        part[pm->position[i]] = total[i];
+    }
+
+    for (p = 0; p < num_pools; p++) {
+
+        pm->pools[p].rm = rm_create(pm->pools[p].size,
+                                    part + pm->pools[p].offset, capacity);
+        if (pm->pools[p].rm == NULL) {
+            free(part);
+            pm_destroy(pm);
+            return NULL;
+        }
+    }
+
+    free(part);
+    return pm;
+}
+
+void pm_destroy(PoolManager *pm) {
+
+    int p;
+
+    if (pm == NULL) {
+        return;
+    }
+
+    if (pm->pools != NULL) {
+        for (p = 0; p < pm->num_pools; p++) {
+            rm_destroy(pm->pools[p].rm);
+        }
+    }
+
+    pthread_mutex_destroy(&pm->register_lock);
+    pthread_mutex_destroy(&pm->pending_lock);
+    free(pm->pools);
+    free(pm->position);
+    free(pm->home);
+    free(pm->span);
+    free(pm->split);
+    free(pm->held);
+    free(pm->member);
+    free(pm->active);
+    free(pm->list_head);
+    free(pm->list_tail);
+    free(pm->request);
+    free(pm->available);
+    free(pm->next_pending);
+    free(pm->previous_pending);
+    free(pm->pending_list);
+    free(pm->pending);
+    free(pm->done);
+    free(pm->context);
+    free(pm->last_status);
+    free(pm);
+}
+
+RmStatus pm_register(PoolManager *pm, int pid, const int *max_need) {
+
+    int p;
+    int q;
+    int *split;
+    bool *member;
+    RmStatus status = RM_GRANTED;
+
+    if (pid < 0 || pid >= pm->capacity || pm->active[pid]) {
+        return RM_INVALID;
+    }
+
+    split = split_row(pm, pid, max_need);
+    member = ROW(pm, member, pid, member_stride);
+
+    /* join the pools the process needs, or the first if it needs none */
+    pm->span[pid] = 0;
+    for (p = 0; p < pm->num_pools; p++) {
+
+        member[p] = !is_zero(pm, split, p);
+        if (member[p]) {
+            pm->home[pid] = p;
+            pm->span[pid]++;
+        }
+    }
+
+    if (pm->span[pid] == 0) {
+        member[0] = true;
+        pm->home[pid] = 0;
+        pm->span[pid] = 1;
+    }
+
+    if (pm->span[pid] == 1) {
+
+        p = pm->home[pid];
+        status = rm_register(pm->pools[p].rm, pid,
+                             split + pm->pools[p].offset);
+    } else {
+
+        /* shared processes join their pools in the same order in all */
+        pthread_mutex_lock(&pm->register_lock);
+
+        for (p = 0; p < pm->num_pools && status == RM_GRANTED; p++) {
+
+            if (member[p]) {
+                status = rm_register_shared(pm->pools[p].rm, pid,
+                                            split + pm->pools[p].offset);
+            }
+        }
+
+        /* leave the pools joined if one refused */
+        if (status != RM_GRANTED) {
+            for (q = 0; q < p - 1; q++) {
+                if (member[q]) {
+                    rm_exit(pm->pools[q].rm, pid);
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&pm->register_lock);
+
+        if (status == RM_GRANTED) {
+            atomic_fetch_add(&pm->shared, 1);
+        }
+    }
+
+    if (status == RM_GRANTED) {
+        memset(ROW(pm, held, pid, stride), 0,
+               pm->num_resources * sizeof(int));
+        pm->active[pid] = true;
+        atomic_fetch_add(&pm->registered, 1);
+    }
+
+    return status;
+}
+
+/* Function to decide a request of pid, storing in pool the pool that
+ * decided it or, for a request spanning pools, the pool that denied it */
+static RmStatus decide(PoolManager *pm, int pid, const int *resources,
+                       int *pool) {
+
+    int p;
+    int q;
+    int touched;
+    int *split;
+    RmStatus status = RM_GRANTED;
+
+    *pool = pm->home[pid];
+
+    split = split_row(pm, pid, resources);
+    if (!check_pools(pm, pid, split, &touched)) {
+        return RM_INVALID;
+    }
+
+    /* a request for one pool is decided by the pool, an empty request by
+     * the pool the process joined last */
+    if (pm->span[pid] == 1 || touched <= 1) {
+
+        for (p = 0; p < pm->num_pools; p++) {
+            if (touched == 0 ? p == pm->home[pid] : !is_zero(pm, split, p)) {
+                status = rm_request(pm->pools[p].rm, pid,
+                                    split + pm->pools[p].offset);
+                *pool = p;
+                break;
+            }
+        }
+    } else {
+
+        /* prepare the request in every pool it spans, in pool order */
+        for (p = 0; p < pm->num_pools && status == RM_GRANTED; p++) {
+            if (!is_zero(pm, split, p)) {
+                status = rm_prepare(pm->pools[p].rm, pid,
+                                    split + pm->pools[p].offset);
+            }
+        }
+
+        /* commit in every pool, or roll back the pools prepared */
+        *pool = p - 1;
+        for (q = (status == RM_GRANTED ? p : p - 1) - 1; q >= 0; q--) {
+            if (!is_zero(pm, split, q)) {
+                if (status == RM_GRANTED) {
+                    rm_commit(pm->pools[q].rm);
+                } else {
+                    rm_abort(pm->pools[q].rm, pid,
+                             split + pm->pools[q].offset);
+                }
+            }
+        }
+
+        atomic_fetch_add(status == RM_GRANTED ? &pm->cross_grants :
+                         &pm->cross_denials, 1);
+    }
+
+    /* the releases of shared processes are checked against what they hold */
+    if (status == RM_GRANTED && pm->span[pid] > 1) {
+        vector_add(ROW(pm, held, pid, stride), resources, pm->num_resources);
+    }
+
+    return status;
+}
+
+RmStatus pm_request(PoolManager *pm, int pid, const int *resources) {
+
+    int pool;
+
+    if (pid < 0 || pid >= pm->capacity || !pm->active[pid]) {
+        return RM_INVALID;
+    }
+
+    return decide(pm, pid, resources, &pool);
+}
+
+/* Function to pick the pending list of the request of pid denied with
+ * status by pool p: the list of the first resource of p it is short on,
+ * or the list of the pool if it was unsafe or is no longer short */
+static int choose_list(PoolManager *pm, int pid, RmStatus status, int p) {
+
+    int i;
+    int *split = ROW(pm, split, pid, stride);
+    int *available = ROW(pm, available, pid, stride);
+
+    if (status == RM_UNAVAILABLE) {
+
+        rm_available(pm->pools[p].rm, available);
+        for (i = 0; i < pm->pools[p].size; i++) {
+            if (split[pm->pools[p].offset + i] > available[i]) {
+                return pm->pools[p].offset + i;
+            }
+        }
+    }
+
+    return pm->num_resources + p;
+}
+
+/* Function to add pid to the tail of a pending list */
+static void link_pending(PoolManager *pm, int pid, int list) {
+
+    pm->pending_list[pid] = list;
+    pm->next_pending[pid] = -1;
+    pm->previous_pending[pid] = pm->list_tail[list];
+
+    if (pm->list_tail[list] == -1) {
+        pm->list_head[list] = pid;
+    } else {
+        pm->next_pending[pm->list_tail[list]] = pid;
+    }
+    pm->list_tail[list] = pid;
+}
+
+/* Function to take pid off its pending list */
+static void unlink_pending(PoolManager *pm, int pid) {
+
+    int list = pm->pending_list[pid];
+
+    if (pm->previous_pending[pid] == -1) {
+        pm->list_head[list] = pm->next_pending[pid];
+    } else {
+        pm->next_pending[pm->previous_pending[pid]] = pm->next_pending[pid];
+    }
+
+    if (pm->next_pending[pid] == -1) {
+        pm->list_tail[list] = pm->previous_pending[pid];
+    } else {
+        pm->previous_pending[pm->next_pending[pid]] = pm->previous_pending[pid];
+    }
+}
+
+/* Function to link pid to the chain of requests to complete, kept in
+ * order through next_pending from first to last */
+static void chain_pending(PoolManager *pm, int pid, int *first, int *last) {
+
+    pm->next_pending[pid] = -1;
+    if (*last == -1) {
+        *first = pid;
+    } else {
+        pm->next_pending[*last] = pid;
+    }
+    *last = pid;
+}
+
+/* Function to take every pending request when every process is pending,
+ * as no release can come, chaining them to those to complete with the
+ * status of their last denial */
+static void stall_pending(PoolManager *pm, int *first, int *last) {
+
+    int list;
+    int pid;
+    int next;
+
+    if (atomic_load(&pm->pending_count) != atomic_load(&pm->registered)) {
+        return;
+    }
+
+    for (list = 0; list < pm->num_lists; list++) {
+
+        for (pid = pm->list_head[list]; pid != -1; pid = next) {
+            next = pm->next_pending[pid];
+            pm->pending[pid] = false;
+            pm->stalled_total++;
+            chain_pending(pm, pid, first, last);
+        }
+
+        pm->list_head[list] = -1;
+        pm->list_tail[list] = -1;
+    }
+
+    atomic_store(&pm->pending_count, 0);
+}
+
+/* Function to call the callbacks of the requests chained from first. The
+ * link is read before each call, as the callback may make pid pending
+ * again */
+static void fire_pending(PoolManager *pm, int first) {
+
+    int pid;
+    int next;
+
+    for (pid = first; pid != -1; pid = next) {
+        next = pm->next_pending[pid];
+        pm->done[pid](pid, pm->last_status[pid], pm->context[pid]);
+    }
+}
+
+/* Function to retry the requests pending on one list, chaining those
+ * decided to complete them and moving those now short on another
+ * resource to its list */
+static void retry_list(PoolManager *pm, int list, int *first, int *last) {
+
+    int p;
+    int pid;
+    int next;
+    int moved;
+    int stop = pm->list_tail[list];
+    RmStatus status;
+
+    /* requests moved to the tail of this list are not retried again */
+    for (pid = pm->list_head[list]; pid != -1; pid = next) {
+
+        next = pid == stop ? -1 : pm->next_pending[pid];
+
+        pm->retries++;
+        status = decide(pm, pid, ROW(pm, request, pid, stride), &p);
+        pm->last_status[pid] = status;
+
+        if (status == RM_GRANTED || status == RM_INVALID) {
+            unlink_pending(pm, pid);
+            pm->pending[pid] = false;
+            atomic_fetch_sub(&pm->pending_count, 1);
+            chain_pending(pm, pid, first, last);
+            continue;
+        }
+
+        moved = choose_list(pm, pid, status, p);
+        if (moved != list) {
+            unlink_pending(pm, pid);
+            link_pending(pm, pid, moved);
+        }
+    }
+}
+
+/* Function to complete the pending requests a release or exit of pid may
+ * satisfy: those short on a resource of split it returned, or on any
+ * resource of its pools if split is NULL, and those denied as unsafe by
+ * the pools it returned resources to */
+static void complete_pending(PoolManager *pm, int pid, const int *split) {
+
+    int i;
+    int p;
+    int first = -1;
+    int last = -1;
+    bool *member = ROW(pm, member, pid, member_stride);
+
+    /* bump the count before looking for requests, see the top. An exit
+     * stops counting pid among the processes that can release only once
+     * the requests it may satisfy were retried, or the others could be
+     * taken for stalled meanwhile */
+    atomic_fetch_add(&pm->releases, 1);
+    if (atomic_load(&pm->pending_count) == 0) {
+        if (split == NULL) {
+            atomic_fetch_sub(&pm->registered, 1);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pm->pending_lock);
+
+    for (p = 0; p < pm->num_pools; p++) {
+
+        if (!member[p] || (split != NULL && is_zero(pm, split, p))) {
+            continue;
+        }
+
+        for (i = pm->pools[p].offset;
+             i < pm->pools[p].offset + pm->pools[p].size; i++) {
+            if (split == NULL || split[i] > 0) {
+                retry_list(pm, i, &first, &last);
+            }
+        }
+
+        retry_list(pm, pm->num_resources + p, &first, &last);
+    }
+
+    if (split == NULL) {
+        atomic_fetch_sub(&pm->registered, 1);
+    }
+
+    stall_pending(pm, &first, &last);
+    pthread_mutex_unlock(&pm->pending_lock);
+
+    fire_pending(pm, first);
+}
+
+RmStatus pm_release(PoolManager *pm, int pid, const int *resources) {
+
+    int p;
+    int touched;
+    int *split;
+    int *held;
+
+    if (pid < 0 || pid >= pm->capacity || !pm->active[pid]) {
+        return RM_INVALID;
+    }
+
+    split = split_row(pm, pid, resources);
+    if (!check_pools(pm, pid, split, &touched)) {
+        return RM_INVALID;
+    }
+
+    if (pm->span[pid] == 1 || touched == 0) {
+
+        p = pm->home[pid];
+        if (rm_release(pm->pools[p].rm, pid,
+                       split + pm->pools[p].offset) != RM_GRANTED) {
+            return RM_INVALID;
+        }
+
+        complete_pending(pm, pid, split);
+        return RM_GRANTED;
+    }
+
+    /* check the whole release before releasing in any pool */
+    held = ROW(pm, held, pid, stride);
+    if (!non_negative(pm, resources) ||
+        !vector_less_equal(resources, held, pm->num_resources)) {
+        return RM_INVALID;
+    }
+
+    for (p = 0; p < pm->num_pools; p++) {
+        if (!is_zero(pm, split, p)) {
+            rm_release(pm->pools[p].rm, pid, split + pm->pools[p].offset);
+        }
+    }
+
+    vector_subtract(held, resources, pm->num_resources);
+    complete_pending(pm, pid, split);
+    return RM_GRANTED;
+}
+
+RmStatus pm_exit(PoolManager *pm, int pid) {
+
+    int p;
+    bool *member;
+
+    if (pid < 0 || pid >= pm->capacity || !pm->active[pid]) {
+        return RM_INVALID;
+    }
+
+    /* only pid can make itself pending, so no lock is needed to look */
+    if (pm->pending[pid]) {
+        return RM_INVALID;
+    }
+
+    member = ROW(pm, member, pid, member_stride);
+
+    for (p = 0; p < pm->num_pools; p++) {
+        if (member[p]) {
+            rm_exit(pm->pools[p].rm, pid);
+        }
+    }
+
+    pm->active[pid] = false;
+    complete_pending(pm, pid, NULL);
+
+    for (p = 0; p < pm->num_pools; p++) {
+        member[p] = false;
+    }
+
+    return RM_GRANTED;
+}
+
+RmStatus pm_request_async(PoolManager *pm, int pid, const int *resources,
+                          PmCallback done, void *context) {
+
+    int p;
+    int list;
+    int first = -1;
+    int last = -1;
+    long releases;
+    int *request;
+    RmStatus status = RM_INVALID;
+
+    if (pid >= 0 && pid < pm->capacity && pm->active[pid] &&
+        !pm->pending[pid]) {
+
+        request = ROW(pm, request, pid, stride);
+        memcpy(request, resources, pm->num_resources * sizeof(int));
+
+        while (true) {
+
+            releases = atomic_load(&pm->releases);
+
+            status = decide(pm, pid, request, &p);
+            if (status == RM_GRANTED || status == RM_INVALID) {
+                break;
+            }
+
+            list = choose_list(pm, pid, status, p);
+
+            pthread_mutex_lock(&pm->pending_lock);
+
+            pm->done[pid] = done;
+            pm->context[pid] = context;
+            pm->last_status[pid] = status;
+            pm->pending[pid] = true;
+            link_pending(pm, pid, list);
+            atomic_fetch_add(&pm->pending_count, 1);
+
+            /* retry if a release came after the request was denied, as
+             * it may have missed the request, see the top */
+            if (atomic_load(&pm->releases) != releases) {
+                unlink_pending(pm, pid);
+                pm->pending[pid] = false;
+                atomic_fetch_sub(&pm->pending_count, 1);
+                pthread_mutex_unlock(&pm->pending_lock);
+                continue;
+            }
+
+            pm->pending_total++;
+            stall_pending(pm, &first, &last);
+
+            pthread_mutex_unlock(&pm->pending_lock);
+
+            fire_pending(pm, first);
+            return RM_PENDING;
+        }
+    }
+
+    done(pid, status, context);
+    return status;
+}
+
+RmStatus pm_request_future(PoolManager *pm, int pid, const int *resources,
+                           PmFuture *future) {
+
+    pthread_mutex_lock(&future->lock);
+    future->ready = false;
+    pthread_mutex_unlock(&future->lock);
+
+    return pm_request_async(pm, pid, resources, pm_future_complete, future);
+}
+
+void pm_future_init(PmFuture *future) {
+
+    pthread_mutex_init(&future->lock, NULL);
+    pthread_cond_init(&future->done, NULL);
+    future->ready = false;
+    future->status = RM_PENDING;
+}
+
+void pm_future_destroy(PmFuture *future) {
+
+    pthread_cond_destroy(&future->done);
+    pthread_mutex_destroy(&future->lock);
+}
+
+RmStatus pm_future_wait(PmFuture *future) {
+
+    RmStatus status;
+
+    pthread_mutex_lock(&future->lock);
+    while (!future->ready) {
+        pthread_cond_wait(&future->done, &future->lock);
+    }
+    status = future->status;
+    pthread_mutex_unlock(&future->lock);
+
+    return status;
+}
+
+void pm_future_complete(int pid, RmStatus status, void *future) {
+
+    PmFuture *f = future;
+
+    (void) pid;
+
+    pthread_mutex_lock(&f->lock);
+    f->status = status;
+    f->ready = true;
+    pthread_cond_signal(&f->done);
+    pthread_mutex_unlock(&f->lock);
+}
+
+void pm_stats(PoolManager *pm, PoolStats *stats) {
+
+    int p;
+    RmStats pool;
+
+    memset(stats, 0, sizeof(PoolStats));
+
+    for (p = 0; p < pm->num_pools; p++) {
+
+        rm_stats(pm->pools[p].rm, &pool);
+        stats->decisions.fast_grants += pool.fast_grants;
+        stats->decisions.slow_grants += pool.slow_grants;
+        stats->decisions.unavailable += pool.unavailable;
+        stats->decisions.unsafe += pool.unsafe;
+        stats->decisions.fast_releases += pool.fast_releases;
+        stats->decisions.slow_releases += pool.slow_releases;
+    }
+
+    /* a committed grant is counted here rather than by each pool */
+    stats->shared = atomic_load(&pm->shared);
+    stats->cross_grants = atomic_load(&pm->cross_grants);
+    stats->cross_denials = atomic_load(&pm->cross_denials);
+    stats->decisions.slow_grants += stats->cross_grants;
+
+    pthread_mutex_lock(&pm->pending_lock);
+    stats->pending = pm->pending_total;
+    stats->stalled = pm->stalled_total;
+    stats->retries = pm->retries;
+    pthread_mutex_unlock(&pm->pending_lock);
+}
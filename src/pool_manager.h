@@ -0,0 +1,107 @@
+/**
+ * Resource manager sharded into pools of resources. Each pool runs the
+ * Banker's algorithm over its own group of resources with its own state,
+ * lock and safety check, so calls decided by different pools never
+ * contend. A request for resources of several pools is granted by an
+ * ordered two phase grant across them. Requests may also be made
+ * asynchronously, completing when a release lets them be granted
+ **/
+
+#ifndef POOL_MANAGER_H
+#define POOL_MANAGER_H
+
+#include <pthread.h>
+#include "resource_manager.h"
+
+typedef struct PoolManager PoolManager;
+
+/* Function called when an asynchronous request of pid is decided, with
+ * the context it was made with */
+typedef void (*PmCallback)(int pid, RmStatus status, void *context);
+
+/* Result of an asynchronous request that a thread can wait for */
+typedef struct PmFuture {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    bool ready;
+    RmStatus status;
+} PmFuture;
+
+/* Counters of the pools. The decisions are summed over the pools, a
+ * request spanning several pools counting once and a release once in
+ * every pool it returns resources to. pending counts the asynchronous
+ * requests that were queued, stalled those completed ungranted and
+ * retries the times a release decided a pending request again */
+typedef struct PoolStats {
+    RmStats decisions;
+    long shared;
+    long cross_grants;
+    long cross_denials;
+    long pending;
+    long stalled;
+    long retries;
+} PoolStats;
+
+/* Function to create a manager for num_resources resources with the
+ * given totals and up to capacity processes, resource i belonging to
+ * pool pool_of[i] of num_pools */
+PoolManager *pm_create(int num_resources, const int *total, int capacity,
+                       int num_pools, const int *pool_of);
+
+/* Function to free a manager */
+void pm_destroy(PoolManager *pm);
+
+/* Function to start process pid with its max need. The process joins
+ * every pool it needs resources of, and is shared by them if there are
+ * several. Returns RM_INVALID if pid is in use or the max need exceeds
+ * the total resources */
+RmStatus pm_register(PoolManager *pm, int pid, const int *max_need);
+
+/* Function to request resources for pid. A request for the resources of
+ * one pool is decided by that pool, one spanning several is prepared in
+ * each of them in pool order and granted only if every pool grants it.
+ * A request for the resources of a pool the process did not join is
+ * RM_INVALID */
+RmStatus pm_request(PoolManager *pm, int pid, const int *resources);
+
+/* Function to request resources for pid without waiting. A request that
+ * is decided at once calls done before returning and returns its status.
+ * Otherwise it is kept pending and RM_PENDING is returned: every release
+ * and exit retries, oldest first, the pending requests short on the
+ * resources it returned or denied as unsafe by the pools it returned
+ * them to, and calls done for those granted, from the thread that
+ * released. If every process is left pending no release can come, and
+ * their requests are completed with the status of their last denial. A
+ * process has at most one pending request, and makes no other call
+ * while it is pending */
+RmStatus pm_request_async(PoolManager *pm, int pid, const int *resources,
+                          PmCallback done, void *context);
+
+/* Function to make an asynchronous request completing a future */
+RmStatus pm_request_future(PoolManager *pm, int pid, const int *resources,
+                           PmFuture *future);
+
+/* Function to prepare a future, before its first use */
+void pm_future_init(PmFuture *future);
+
+/* Function to free a future */
+void pm_future_destroy(PmFuture *future);
+
+/* Function to wait until a future is completed. Returns its status */
+RmStatus pm_future_wait(PmFuture *future);
+
+/* Function to complete a future, the callback of pm_request_future() */
+void pm_future_complete(int pid, RmStatus status, void *future);
+
+/* Function to release resources held by pid. Returns RM_INVALID without
+ * releasing anything if pid holds less than resources */
+RmStatus pm_release(PoolManager *pm, int pid, const int *resources);
+
+/* Function to end process pid, releasing everything it holds. A process
+ * with a pending request cannot end */
+RmStatus pm_exit(PoolManager *pm, int pid);
+
+/* Function to read the counters of the manager */
+void pm_stats(PoolManager *pm, PoolStats *stats);
+
+#endif
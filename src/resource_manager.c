@@ -0,0 +1,646 @@
+/**
+ * Thread safe resource manager implementing the Banker's algorithm for
+ * processes run by concurrent threads.
+ *
+ * Calls for different processes may be made at the same time, calls for
+ * one process have to come from one thread at a time. Each call is
+ * decided as the serial algorithm would decide it at some point between
+ * the start and the end of the call.
+ *
+ * When the available resources fit in one 64 bit word (up to four
+ * resources of at most PACKED_MAX units) they are kept packed in an
+ * atomic state word. A request that leaves the requester able to finish
+ * with what is available, or a release, then commits with a single
+ * compare and swap. Anything else takes the mutex and runs the full
+ * safety check.
+ *
+ * Processes may also be registered as shared with other managers, each
+ * managing a separate group of resources. The safety check finishes the
+ * shared processes in the order they were registered, so that the safe
+ * sequences of the managers merge into one safe sequence of the whole
+ * system, and requests of shared processes never take the fast path.
+ **/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "resource_manager.h"
+#include "vector_kernels.h"
+
+/* Layout of the packed state word: four 14 bit available counts, a 7 bit
+ * count of fast path calls updating their rows, and the lock bit that
+ * closes the fast path while the mutex holder works on the state */
+#define PACKED_RESOURCES 4
+#define PACKED_BITS 14
+#define PACKED_MAX ((1 << PACKED_BITS) - 1)
+#define INFLIGHT_SHIFT (PACKED_RESOURCES * PACKED_BITS)
+#define INFLIGHT_ONE ((uint64_t) 1 << INFLIGHT_SHIFT)
+#define INFLIGHT_MAX 127
+#define LOCKED_BIT ((uint64_t) 1 << 63)
+
+#define INFLIGHT(word) (((word) >> INFLIGHT_SHIFT) & INFLIGHT_MAX)
+
+/* Rows are padded to this many ints like the simulator's matrices */
+#define ROW_ALIGNMENT 8
+
+struct ResourceManager {
+    int num_resources;
+    int capacity;
+    int stride;
+    int *total;
+    int *available;
+    int *max_need;
+    int *allocation;
+    int *work;
+    bool *active;
+    bool *finished;
+    bool *shared;
+    int *chain;
+    int chain_length;
+    bool packed;
+    _Atomic uint64_t state;
+    pthread_mutex_t lock;
+    _Atomic long fast_grants;
+    _Atomic long slow_grants;
+    _Atomic long unavailable;
+    _Atomic long unsafe;
+    _Atomic long fast_releases;
+    _Atomic long slow_releases;
+};
+
+/* Macro to address the row of a process */
+#define ROW(rm, matrix, pid) ((rm)->matrix + (size_t) (pid) * (rm)->stride)
+
+/* Function to pack available counts into a state word */
+static uint64_t pack(ResourceManager *rm, const int *values) {
+
+    int i;
+    uint64_t word = 0;
+
+    for (i = 0; i < rm->num_resources; i++) {
+        word |= (uint64_t) values[i] << (i * PACKED_BITS);
+    }
+
+    return word;
+}
+
+/* Function to unpack the available counts of a state word */
+static void unpack(ResourceManager *rm, uint64_t word, int *values) {
+
+    int i;
+
+    for (i = 0; i < rm->num_resources; i++) {
+        values[i] = (word >> (i * PACKED_BITS)) & PACKED_MAX;
+    }
+}
+
+/* Function to check that a vector has no negative values */
+static bool non_negative(ResourceManager *rm, const int *values) {
+
+    int i;
+
+    for (i = 0; i < rm->num_resources; i++) {
+        if (values[i] < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Function to check that pid is active and that resources is within its
+ * remaining need. Only calls for pid change its row, so the check needs
+ * no lock */
+static bool valid_request(ResourceManager *rm, int pid,
+                          const int *resources) {
+
+    int i;
+    int *max_need;
+    int *allocation;
+
+    if (pid < 0 || pid >= rm->capacity || !rm->active[pid]) {
+        return false;
+    }
+
+    max_need = ROW(rm, max_need, pid);
+    allocation = ROW(rm, allocation, pid);
+
+    for (i = 0; i < rm->num_resources; i++) {
+        if (resources[i] < 0 || resources[i] > max_need[i] - allocation[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Function to take the mutex and close the fast path. Once every fast
+ * path call in flight has updated its row, available and every row are
+ * consistent and only the caller changes them */
+static void lock_state(ResourceManager *rm) {
+
+    uint64_t word;
+
+    pthread_mutex_lock(&rm->lock);
+
+    if (!rm->packed) {
+        return;
+    }
+
+    word = atomic_fetch_or(&rm->state, LOCKED_BIT) | LOCKED_BIT;
+    while (INFLIGHT(word) != 0) {
+        sched_yield();
+        word = atomic_load(&rm->state);
+    }
+
+    unpack(rm, word, rm->available);
+}
+
+/* Function to publish available and reopen the fast path */
+static void unlock_state(ResourceManager *rm) {
+
+    if (rm->packed) {
+        atomic_store(&rm->state, pack(rm, rm->available));
+    }
+
+    pthread_mutex_unlock(&rm->lock);
+}
+
+/* Function to check if the active processes can all finish with the
+ * available resources, the shared processes in the order of the chain.
+ * Called with the state locked */
+static bool is_safe(ResourceManager *rm) {
+
+    int i;
+    int next = 0;
+    int remaining = 0;
+    bool progress = true;
+
+    memcpy(rm->work, rm->available, rm->stride * sizeof(int));
+
+    for (i = 0; i < rm->capacity; i++) {
+        rm->finished[i] = !rm->active[i];
+        if (rm->active[i]) {
+            remaining++;
+        }
+    }
+
+    /* keep finishing processes until none are left or none can finish */
+    while (remaining > 0 && progress) {
+
+        progress = false;
+
+        for (i = 0; i < rm->capacity; i++) {
+
+            /* a shared process waits for those registered before it */
+            if (!rm->finished[i] &&
+                (!rm->shared[i] || rm->chain[next] == i) &&
+                vector_difference_less_equal(ROW(rm, max_need, i),
+                                             ROW(rm, allocation, i),
+                                             rm->work, rm->num_resources)) {
+
+                vector_add(rm->work, ROW(rm, allocation, i),
+                           rm->num_resources);
+                rm->finished[i] = true;
+                remaining--;
+                progress = true;
+
+                if (rm->shared[i]) {
+                    next++;
+                }
+            }
+        }
+    }
+
+    return remaining == 0;
+}
+
+/* Function to grant a request without the lock if it is obviously safe.
+ * The state was safe before, and if the requester's whole remaining need
+ * fits in what is available it can finish first in the new state, after
+ * which the old safe sequence still holds. Returns false if the request
+ * has to take the slow path */
+static bool fast_request(ResourceManager *rm, int pid, const int *resources) {
+
+    int i;
+    int available[PACKED_RESOURCES];
+    int *max_need = ROW(rm, max_need, pid);
+    int *allocation = ROW(rm, allocation, pid);
+    uint64_t word;
+    uint64_t next;
+
+    word = atomic_load(&rm->state);
+
+    do {
+
+        if ((word & LOCKED_BIT) || INFLIGHT(word) == INFLIGHT_MAX) {
+            return false;
+        }
+
+        unpack(rm, word, available);
+
+        for (i = 0; i < rm->num_resources; i++) {
+            if (resources[i] > available[i] ||
+                max_need[i] - allocation[i] > available[i]) {
+                return false;
+            }
+        }
+
+        next = word - pack(rm, resources) + INFLIGHT_ONE;
+
+    } while (!atomic_compare_exchange_weak(&rm->state, &word, next));
+
+    /* the row is updated before leaving the in flight count */
+    vector_add(allocation, resources, rm->num_resources);
+    atomic_fetch_sub(&rm->state, INFLIGHT_ONE);
+
+    atomic_fetch_add(&rm->fast_grants, 1);
+    return true;
+}
+
+/* Function to release resources without the lock. A release always
+ * leaves a safe state safe. Returns false if the release has to take the
+ * slow path */
+static bool fast_release(ResourceManager *rm, int pid, const int *resources) {
+
+    int i;
+    int available[PACKED_RESOURCES];
+    uint64_t word;
+    uint64_t next;
+
+    word = atomic_load(&rm->state);
+
+    do {
+
+        if ((word & LOCKED_BIT) || INFLIGHT(word) == INFLIGHT_MAX) {
+            return false;
+        }
+
+        unpack(rm, word, available);
+        for (i = 0; i < rm->num_resources; i++) {
+            if (available[i] + resources[i] > PACKED_MAX) {
+                return false;
+            }
+        }
+
+        next = word + pack(rm, resources) + INFLIGHT_ONE;
+
+    } while (!atomic_compare_exchange_weak(&rm->state, &word, next));
+
+    vector_subtract(ROW(rm, allocation, pid), resources, rm->num_resources);
+    atomic_fetch_sub(&rm->state, INFLIGHT_ONE);
+
+    atomic_fetch_add(&rm->fast_releases, 1);
+    return true;
+}
+
+ResourceManager *rm_create(int num_resources, const int *total, int capacity) {
+
+    int i;
+    ResourceManager *rm;
+
+    if (num_resources <= 0 || capacity <= 0) {
+        return NULL;
+    }
+
+    rm = calloc(1, sizeof(ResourceManager));
+    if (rm == NULL) {
+        return NULL;
+    }
+
+    rm->num_resources = num_resources;
+    rm->capacity = capacity;
+    rm->stride = (num_resources + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT *
+                 ROW_ALIGNMENT;
+
+    rm->total = calloc(rm->stride, sizeof(int));
+    rm->available = calloc(rm->stride, sizeof(int));
+    rm->work = calloc(rm->stride, sizeof(int));
+    rm->max_need = calloc((size_t) capacity * rm->stride, sizeof(int));
+    rm->allocation = calloc((size_t) capacity * rm->stride, sizeof(int));
+    rm->active = calloc(capacity, sizeof(bool));
+    rm->finished = calloc(capacity, sizeof(bool));
+    rm->shared = calloc(capacity, sizeof(bool));
+    rm->chain = calloc(capacity, sizeof(int));
+
+    if (rm->total == NULL || rm->available == NULL || rm->work == NULL ||
+        rm->max_need == NULL || rm->allocation == NULL ||
+        rm->active == NULL || rm->finished == NULL || rm->shared == NULL ||
+        rm->chain == NULL) {
+        rm_destroy(rm);
+        return NULL;
+    }
+
+    memcpy(rm->total, total, num_resources * sizeof(int));
+    memcpy(rm->available, total, num_resources * sizeof(int));
+
+    /* use the packed state word if the totals fit in it */
+    rm->packed = num_resources <= PACKED_RESOURCES;
+    for (i = 0; i < num_resources; i++) {
+        if (total[i] < 0 || total[i] > PACKED_MAX) {
+            rm->packed = false;
+        }
+    }
+
+    atomic_init(&rm->state, rm->packed ? pack(rm, rm->available) : 0);
+    pthread_mutex_init(&rm->lock, NULL);
+
+    return rm;
+}
+
+void rm_destroy(ResourceManager *rm) {
+
+    if (rm == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&rm->lock);
+    free(rm->total);
+    free(rm->available);
+    free(rm->work);
+    free(rm->max_need);
+    free(rm->allocation);
+    free(rm->active);
+    free(rm->finished);
+    free(rm->shared);
+    free(rm->chain);
+    free(rm);
+}
+
+/* Function to start a process, appending it to the chain if shared */
+static RmStatus register_process(ResourceManager *rm, int pid,
+                                 const int *max_need, bool shared) {
+
+    RmStatus status = RM_GRANTED;
+
+    if (pid < 0 || pid >= rm->capacity || !non_negative(rm, max_need)) {
+        return RM_INVALID;
+    }
+
+    lock_state(rm);
+
+    /* a process that can never finish would leave no safe state */
+    if (rm->active[pid] ||
+        !vector_less_equal(max_need, rm->total, rm->num_resources)) {
+
+        status = RM_INVALID;
+    } else {
+
+        memcpy(ROW(rm, max_need, pid), max_need,
+               rm->num_resources * sizeof(int));
+        memset(ROW(rm, allocation, pid), 0, rm->num_resources * sizeof(int));
+        rm->active[pid] = true;
+        rm->shared[pid] = shared;
+
+        /* holding nothing, it can finish after everyone else */
+        if (shared) {
+            rm->chain[rm->chain_length++] = pid;
+        }
+    }
+
+    unlock_state(rm);
+    return status;
+}
+
+RmStatus rm_register(ResourceManager *rm, int pid, const int *max_need) {
+
+    return register_process(rm, pid, max_need, false);
+}
+
+RmStatus rm_register_shared(ResourceManager *rm, int pid,
+                            const int *max_need) {
+
+    return register_process(rm, pid, max_need, true);
+}
+
+/* Function to make the allocation of a request if the resources are
+ * available and a safe state is reached, counting a denial. Called with
+ * the state locked */
+static RmStatus allocate_request(ResourceManager *rm, int pid,
+                                 const int *resources) {
+
+    int *allocation = ROW(rm, allocation, pid);
+
+    if (!vector_less_equal(resources, rm->available, rm->num_resources)) {
+
+        atomic_fetch_add(&rm->unavailable, 1);
+        return RM_UNAVAILABLE;
+    }
+
+    /* make the allocation tentatively */
+    vector_add(allocation, resources, rm->num_resources);
+    vector_subtract(rm->available, resources, rm->num_resources);
+
+    /* roll back if a safe state is not reached */
+    if (!is_safe(rm)) {
+
+        vector_subtract(allocation, resources, rm->num_resources);
+        vector_add(rm->available, resources, rm->num_resources);
+        atomic_fetch_add(&rm->unsafe, 1);
+        return RM_UNSAFE;
+    }
+
+    return RM_GRANTED;
+}
+
+/* Function to decide a request on the slow path. Called with the state
+ * locked */
+static RmStatus decide_request(ResourceManager *rm, int pid,
+                               const int *resources) {
+
+    RmStatus status = allocate_request(rm, pid, resources);
+
+    if (status == RM_GRANTED) {
+        atomic_fetch_add(&rm->slow_grants, 1);
+    }
+
+    return status;
+}
+
+RmStatus rm_request(ResourceManager *rm, int pid, const int *resources) {
+
+    RmStatus status;
+
+    if (!valid_request(rm, pid, resources)) {
+        return RM_INVALID;
+    }
+
+    if (rm->packed && !rm->shared[pid] && fast_request(rm, pid, resources)) {
+        return RM_GRANTED;
+    }
+
+    lock_state(rm);
+    status = decide_request(rm, pid, resources);
+    unlock_state(rm);
+
+    return status;
+}
+
+RmStatus rm_prepare(ResourceManager *rm, int pid, const int *resources) {
+
+    RmStatus status;
+
+    if (!valid_request(rm, pid, resources)) {
+        return RM_INVALID;
+    }
+
+    /* the state stays locked until the request is committed or aborted */
+    lock_state(rm);
+    status = allocate_request(rm, pid, resources);
+    if (status != RM_GRANTED) {
+        unlock_state(rm);
+    }
+
+    return status;
+}
+
+void rm_commit(ResourceManager *rm) {
+
+    unlock_state(rm);
+}
+
+void rm_abort(ResourceManager *rm, int pid, const int *resources) {
+
+    vector_subtract(ROW(rm, allocation, pid), resources, rm->num_resources);
+    vector_add(rm->available, resources, rm->num_resources);
+    unlock_state(rm);
+}
+
+void rm_request_batch(ResourceManager *rm, int count, const int *pids,
+                      const int *const *requests, RmStatus *statuses) {
+
+    int i;
+    int granted = 0;
+
+    lock_state(rm);
+
+    /* make the allocations that are available tentatively */
+    for (i = 0; i < count; i++) {
+
+        if (!valid_request(rm, pids[i], requests[i])) {
+
+            statuses[i] = RM_INVALID;
+        } else if (vector_less_equal(requests[i], rm->available,
+                                     rm->num_resources)) {
+
+            vector_add(ROW(rm, allocation, pids[i]), requests[i],
+                       rm->num_resources);
+            vector_subtract(rm->available, requests[i], rm->num_resources);
+            statuses[i] = RM_GRANTED;
+            granted++;
+        } else {
+
+            statuses[i] = RM_UNAVAILABLE;
+        }
+    }
+
+    /* one safety check decides the whole batch */
+    if (granted == 0 || is_safe(rm)) {
+
+        for (i = 0; i < count; i++) {
+            if (statuses[i] == RM_UNAVAILABLE) {
+                atomic_fetch_add(&rm->unavailable, 1);
+            }
+        }
+
+        atomic_fetch_add(&rm->slow_grants, granted);
+        unlock_state(rm);
+        return;
+    }
+
+    /* roll back and decide the requests one at a time */
+    for (i = 0; i < count; i++) {
+
+        if (statuses[i] == RM_GRANTED) {
+            vector_subtract(ROW(rm, allocation, pids[i]), requests[i],
+                            rm->num_resources);
+            vector_add(rm->available, requests[i], rm->num_resources);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+
+        if (statuses[i] != RM_INVALID) {
+            statuses[i] = decide_request(rm, pids[i], requests[i]);
+        }
+    }
+
+    unlock_state(rm);
+}
+
+RmStatus rm_release(ResourceManager *rm, int pid, const int *resources) {
+
+    if (pid < 0 || pid >= rm->capacity || !rm->active[pid] ||
+        !non_negative(rm, resources) ||
+        !vector_less_equal(resources, ROW(rm, allocation, pid),
+                           rm->num_resources)) {
+        return RM_INVALID;
+    }
+
+    if (rm->packed && fast_release(rm, pid, resources)) {
+        return RM_GRANTED;
+    }
+
+    lock_state(rm);
+
+    vector_add(rm->available, resources, rm->num_resources);
+    vector_subtract(ROW(rm, allocation, pid), resources, rm->num_resources);
+    atomic_fetch_add(&rm->slow_releases, 1);
+
+    unlock_state(rm);
+    return RM_GRANTED;
+}
+
+RmStatus rm_exit(ResourceManager *rm, int pid) {
+
+    int i;
+
+    if (pid < 0 || pid >= rm->capacity || !rm->active[pid]) {
+        return RM_INVALID;
+    }
+
+    lock_state(rm);
+
+    vector_add(rm->available, ROW(rm, allocation, pid), rm->num_resources);
+    memset(ROW(rm, allocation, pid), 0, rm->num_resources * sizeof(int));
+    rm->active[pid] = false;
+
+    /* the rest of the chain keeps its order */
+    if (rm->shared[pid]) {
+
+        for (i = 0; rm->chain[i] != pid; i++);
+        memmove(&rm->chain[i], &rm->chain[i + 1],
+                (rm->chain_length - i - 1) * sizeof(int));
+        rm->chain_length--;
+        rm->shared[pid] = false;
+    }
+
+    unlock_state(rm);
+    return RM_GRANTED;
+}
+
+void rm_available(ResourceManager *rm, int *available) {
+
+    /* the fast path keeps the packed word current while the mutex is
+     * not held by a slow call */
+    pthread_mutex_lock(&rm->lock);
+    if (rm->packed) {
+        unpack(rm, atomic_load(&rm->state), available);
+    } else {
+        memcpy(available, rm->available, rm->num_resources * sizeof(int));
+    }
+    pthread_mutex_unlock(&rm->lock);
+}
+
+void rm_stats(ResourceManager *rm, RmStats *stats) {
+
+    stats->fast_grants = atomic_load(&rm->fast_grants);
+    stats->slow_grants = atomic_load(&rm->slow_grants);
+    stats->unavailable = atomic_load(&rm->unavailable);
+    stats->unsafe = atomic_load(&rm->unsafe);
+    stats->fast_releases = atomic_load(&rm->fast_releases);
+    stats->slow_releases = atomic_load(&rm->slow_releases);
+}
@@ -0,0 +1,95 @@
+/**
+ * Thread safe resource manager implementing the Banker's algorithm for
+ * processes run by concurrent threads
+ **/
+
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <stdbool.h>
+
+/* Results of the resource manager calls */
+typedef enum RmStatus {
+    RM_GRANTED = 0,
+    RM_UNAVAILABLE,
+    RM_UNSAFE,
+    RM_INVALID,
+    RM_PENDING
+} RmStatus;
+
+typedef struct ResourceManager ResourceManager;
+
+/* Counters of how the calls were decided */
+typedef struct RmStats {
+    long fast_grants;
+    long slow_grants;
+    long unavailable;
+    long unsafe;
+    long fast_releases;
+    long slow_releases;
+} RmStats;
+
+/* Function to create a manager for num_resources resources with the
+ * given totals and up to capacity processes, numbered 0 to capacity - 1 */
+ResourceManager *rm_create(int num_resources, const int *total, int capacity);
+
+/* Function to free a manager */
+void rm_destroy(ResourceManager *rm);
+
+/* Function to start process pid with its max need. Returns RM_INVALID
+ * if pid is in use or the max need exceeds the total resources */
+RmStatus rm_register(ResourceManager *rm, int pid, const int *max_need);
+
+/* Function to request resources for pid. The request is granted only if
+ * the resources are available and the system stays in a safe state. A
+ * request above the remaining need of pid, its max need less what it
+ * holds, is RM_INVALID */
+RmStatus rm_request(ResourceManager *rm, int pid, const int *resources);
+
+/* Function to start process pid as one shared with other managers.
+ * Shared processes finish in the order they were registered in every
+ * safe sequence, so they have to be registered with every manager in
+ * the same order */
+RmStatus rm_register_shared(ResourceManager *rm, int pid,
+                            const int *max_need);
+
+/* Function to prepare a request that is granted together with requests
+ * to other managers. On RM_GRANTED the allocation is made and the state
+ * stays locked until rm_commit() keeps it or rm_abort() rolls it back.
+ * Managers have to be prepared in the same order by every thread. A
+ * request above the remaining need of pid is RM_INVALID */
+RmStatus rm_prepare(ResourceManager *rm, int pid, const int *resources);
+
+/* Function to keep the allocation of a prepared request. The grant is
+ * left for the caller to count, once for all the managers */
+void rm_commit(ResourceManager *rm);
+
+/* Function to roll back the prepared request of pid for resources */
+void rm_abort(ResourceManager *rm, int pid, const int *resources);
+
+/* Function to decide the requests of count processes at once, the
+ * request of pids[i] being requests[i]. The requests that are available
+ * are granted together if the state stays safe with all of them, with a
+ * single safety check. Otherwise they are rolled back and decided one at
+ * a time in order, so an unsafe batch costs one full safety check more
+ * than deciding its requests with rm_request(). A request is RM_INVALID
+ * as it is for rm_request(). The result of each request is stored in
+ * statuses */
+void rm_request_batch(ResourceManager *rm, int count, const int *pids,
+                      const int *const *requests, RmStatus *statuses);
+
+/* Function to release resources held by pid. Returns RM_INVALID without
+ * releasing anything if pid holds less than resources */
+RmStatus rm_release(ResourceManager *rm, int pid, const int *resources);
+
+/* Function to end process pid, releasing everything it holds */
+RmStatus rm_exit(ResourceManager *rm, int pid);
+
+/* Function to read the resources available, as they were at some point
+ * during the call */
+void rm_available(ResourceManager *rm, int *available);
+
+/* Function to read the counters of the manager */
+void rm_stats(ResourceManager *rm, RmStats *stats);
+
+#endif
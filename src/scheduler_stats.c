@@ -0,0 +1,188 @@
+/**
+ * Counters of the scheduler hot paths, reported at the end of a run and
+ * dumped periodically as CSV or JSON lines. Building with
+ * -DNO_SCHEDULER_STATS compiles the counting out
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "scheduler_stats.h"
+
+SchedulerStats scheduler_stats;
+bool stats_enabled = false;
+long stats_interval = 100;
+
+#ifdef NO_SCHEDULER_STATS
+
+/* Counting is compiled out */
+int stats_open(const char *path) {
+
+    (void) path;
+
+    printf("Scheduler statistics were compiled out\n");
+    return -1;
+}
+
+long stats_start(void) {
+
+    return 0;
+}
+
+void stats_safety_check(long start) {
+
+    (void) start;
+}
+
+void stats_sample(long tick, int ready, int waiting, int standby) {
+
+    (void) tick;
+    (void) ready;
+    (void) waiting;
+    (void) standby;
+}
+
+int stats_close(void) {
+
+    return 0;
+}
+
+#else
+
+static FILE *dump_file;
+static bool dump_json;
+
+/* Function to read the monotonic clock in nanoseconds */
+static long clock_ns(void) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* Function to start counting */
+int stats_open(const char *path) {
+
+    size_t length;
+
+    memset(&scheduler_stats, 0, sizeof(scheduler_stats));
+    dump_file = NULL;
+
+    if (path != NULL) {
+
+        dump_file = fopen(path, "w");
+        if (dump_file == NULL) {
+            perror(path);
+            return -1;
+        }
+
+        length = strlen(path);
+        dump_json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+        if (!dump_json) {
+            fprintf(dump_file, "tick,safety_checks,prefix_checks,rollbacks,"
+                    "waits,wakes,sleeps,ready,waiting,standby\n");
+        }
+    }
+
+    stats_enabled = true;
+    return 0;
+}
+
+/* Function to read the clock at the start of a safety check */
+long stats_start(void) {
+
+    return clock_ns();
+}
+
+/* Function to count a safety check in the bucket of its latency */
+void stats_safety_check(long start) {
+
+    int bucket = 0;
+    long latency = clock_ns() - start;
+
+    while (latency > 1 && bucket < STATS_BUCKETS - 1) {
+        latency >>= 1;
+        bucket++;
+    }
+
+    scheduler_stats.safety_checks++;
+    scheduler_stats.safety_latency[bucket]++;
+}
+
+/* Function to sample the queue depths and dump the counters */
+void stats_sample(long tick, int ready, int waiting, int standby) {
+
+    SchedulerStats *s = &scheduler_stats;
+
+    s->samples++;
+    s->ready_depth += ready;
+    s->wait_depth += waiting;
+    s->standby_depth += standby;
+    s->ready_max = ready > s->ready_max ? ready : s->ready_max;
+    s->wait_max = waiting > s->wait_max ? waiting : s->wait_max;
+    s->standby_max = standby > s->standby_max ? standby : s->standby_max;
+
+    if (dump_file == NULL) {
+        return;
+    }
+
+    if (dump_json) {
+        fprintf(dump_file, "{\"tick\": %ld, \"safety_checks\": %ld, "
+                "\"prefix_checks\": %ld, \"rollbacks\": %ld, "
+                "\"waits\": %ld, \"wakes\": %ld, \"sleeps\": %ld, "
+                "\"ready\": %d, \"waiting\": %d, \"standby\": %d}\n",
+                tick, s->safety_checks, s->prefix_checks, s->rollbacks,
+                s->waits, s->wakes, s->sleeps, ready, waiting, standby);
+    } else {
+        fprintf(dump_file, "%ld,%ld,%ld,%ld,%ld,%ld,%ld,%d,%d,%d\n",
+                tick, s->safety_checks, s->prefix_checks, s->rollbacks,
+                s->waits, s->wakes, s->sleeps, ready, waiting, standby);
+    }
+}
+
+/* Function to print the report and close the dump */
+int stats_close(void) {
+
+    int i;
+    int status = 0;
+    SchedulerStats *s = &scheduler_stats;
+
+    if (!stats_enabled) {
+        return 0;
+    }
+
+    printf("\nScheduler statistics\n");
+    printf("Safety checks:    %ld full, %ld by the cached prefix\n",
+           s->safety_checks, s->prefix_checks);
+    printf("Rollbacks:        %ld\n", s->rollbacks);
+    printf("Waits:            %ld, woken %ld\n", s->waits, s->wakes);
+    printf("Sleep rotations:  %ld\n", s->sleeps);
+
+    if (s->samples > 0) {
+        printf("Queue depths:     ready %.1f (max %d), waiting %.1f "
+               "(max %d), standby %.1f (max %d) over %ld samples\n",
+               (double) s->ready_depth / s->samples, s->ready_max,
+               (double) s->wait_depth / s->samples, s->wait_max,
+               (double) s->standby_depth / s->samples, s->standby_max,
+               s->samples);
+    }
+
+    if (s->safety_checks > 0) {
+        printf("Safety check latency:\n");
+        for (i = 0; i < STATS_BUCKETS; i++) {
+            if (s->safety_latency[i] > 0) {
+                printf("  < %ld ns\t%ld\n", 2L << i, s->safety_latency[i]);
+            }
+        }
+    }
+
+    if (dump_file != NULL && fclose(dump_file) != 0) {
+        status = -1;
+    }
+
+    stats_enabled = false;
+    return status;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * Counters of the scheduler hot paths, reported at the end of a run and
+ * dumped periodically as CSV or JSON lines. Building with
+ * -DNO_SCHEDULER_STATS compiles the counting out
+ **/
+
+#ifndef SCHEDULER_STATS_H
+#define SCHEDULER_STATS_H
+
+#include <stdbool.h>
+
+/* Safety check latencies are counted in power of two buckets of ns */
+#define STATS_BUCKETS 32
+
+typedef struct SchedulerStats {
+    long safety_checks;
+    long safety_latency[STATS_BUCKETS];
+    long prefix_checks;
+    long rollbacks;
+    long waits;
+    long wakes;
+    long sleeps;
+    long samples;
+    long ready_depth;
+    long wait_depth;
+    long standby_depth;
+    int ready_max;
+    int wait_max;
+    int standby_max;
+} SchedulerStats;
+
+/* Counters, and whether they are kept */
+extern SchedulerStats scheduler_stats;
+extern bool stats_enabled;
+
+/* Ticks of the simulated clock between samples of the queue depths */
+extern long stats_interval;
+
+/* Function to start counting. If path is not NULL a line of counters and
+ * queue depths is written to it every stats_interval ticks, as JSON
+ * lines if path ends in .json and as CSV otherwise. Returns -1 if the
+ * file cannot be created or counting was compiled out */
+int stats_open(const char *path);
+
+/* Function to read the clock at the start of a safety check */
+long stats_start(void);
+
+/* Function to count a safety check started at start */
+void stats_safety_check(long start);
+
+/* Function to sample the queue depths at a tick */
+void stats_sample(long tick, int ready, int waiting, int standby);
+
+/* Function to print the report and close the dump */
+int stats_close(void);
+
+#ifdef NO_SCHEDULER_STATS
+#define STATS_COUNT(counter) ((void) 0)
+#define STATS_ADD(counter, count) ((void) 0)
+#define STATS_START() 0L
+#define STATS_SAFETY_CHECK(start) ((void) (start))
+#define STATS_DUE(tick) false
+#else
+#define STATS_COUNT(counter) STATS_ADD(counter, 1)
+#define STATS_ADD(counter, count)                  \
+    do {                                           \
+        if (stats_enabled) {                       \
+            scheduler_stats.counter += (count);    \
+        }                                          \
+    } while (0)
+#define STATS_START() (stats_enabled ? stats_start() : 0L)
+#define STATS_SAFETY_CHECK(start)                  \
+    do {                                           \
+        if (stats_enabled) {                       \
+            stats_safety_check(start);             \
+        }                                          \
+    } while (0)
+#define STATS_DUE(tick) (stats_enabled && (tick) % stats_interval == 0)
+#endif
+
+#endif
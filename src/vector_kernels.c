@@ -0,0 +1,250 @@
+/**
+ * Vector kernels for comparing and combining rows of resource counts.
+ * An AVX2, SSE4.1 or scalar implementation is selected at runtime
+ **/
+
+#include <stddef.h>
+#include <string.h>
+#include "vector_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/* Scalar kernels, used as the fallback and for the tail of a row */
+static bool scalar_less_equal(const int *a, const int *b, int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (a[i] > b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool scalar_difference_less_equal(const int *a, const int *b,
+                                         const int *c, int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (a[i] - b[i] > c[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void scalar_add(int *a, const int *b, int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        a[i] = a[i] + b[i];
+    }
+}
+
+static void scalar_subtract(int *a, const int *b, int n) {
+
+    int i;
+
+    for (i = 0; i < n; i++) {
+        a[i] = a[i] - b[i];
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* SSE4.1 kernels, four ints at a time */
+__attribute__((target("sse4.1")))
+static bool sse4_less_equal(const int *a, const int *b, int n) {
+
+    int i;
+    __m128i greater;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        greater = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *) (a + i)),
+                                  _mm_loadu_si128((const __m128i *) (b + i)));
+        if (!_mm_testz_si128(greater, greater)) {
+            return false;
+        }
+    }
+
+    return scalar_less_equal(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static bool sse4_difference_less_equal(const int *a, const int *b,
+                                       const int *c, int n) {
+
+    int i;
+    __m128i difference;
+    __m128i greater;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        difference = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (a + i)),
+                                   _mm_loadu_si128((const __m128i *) (b + i)));
+        greater = _mm_cmpgt_epi32(difference,
+                                  _mm_loadu_si128((const __m128i *) (c + i)));
+        if (!_mm_testz_si128(greater, greater)) {
+            return false;
+        }
+    }
+
+    return scalar_difference_less_equal(a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void sse4_add(int *a, const int *b, int n) {
+
+    int i;
+    __m128i sum;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *) (a + i)),
+                            _mm_loadu_si128((const __m128i *) (b + i)));
+        _mm_storeu_si128((__m128i *) (a + i), sum);
+    }
+
+    scalar_add(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void sse4_subtract(int *a, const int *b, int n) {
+
+    int i;
+    __m128i difference;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        difference = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (a + i)),
+                                   _mm_loadu_si128((const __m128i *) (b + i)));
+        _mm_storeu_si128((__m128i *) (a + i), difference);
+    }
+
+    scalar_subtract(a + i, b + i, n - i);
+}
+
+/* AVX2 kernels, eight ints at a time with an SSE4.1 step for the rest */
+__attribute__((target("avx2")))
+static bool avx2_less_equal(const int *a, const int *b, int n) {
+
+    int i;
+    __m256i greater;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        greater = _mm256_cmpgt_epi32(
+            _mm256_loadu_si256((const __m256i *) (a + i)),
+            _mm256_loadu_si256((const __m256i *) (b + i)));
+        if (!_mm256_testz_si256(greater, greater)) {
+            return false;
+        }
+    }
+
+    return sse4_less_equal(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static bool avx2_difference_less_equal(const int *a, const int *b,
+                                       const int *c, int n) {
+
+    int i;
+    __m256i difference;
+    __m256i greater;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        difference = _mm256_sub_epi32(
+            _mm256_loadu_si256((const __m256i *) (a + i)),
+            _mm256_loadu_si256((const __m256i *) (b + i)));
+        greater = _mm256_cmpgt_epi32(
+            difference, _mm256_loadu_si256((const __m256i *) (c + i)));
+        if (!_mm256_testz_si256(greater, greater)) {
+            return false;
+        }
+    }
+
+    return sse4_difference_less_equal(a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_add(int *a, const int *b, int n) {
+
+    int i;
+    __m256i sum;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (a + i)),
+                               _mm256_loadu_si256((const __m256i *) (b + i)));
+        _mm256_storeu_si256((__m256i *) (a + i), sum);
+    }
+
+    sse4_add(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void avx2_subtract(int *a, const int *b, int n) {
+
+    int i;
+    __m256i difference;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        difference = _mm256_sub_epi32(
+            _mm256_loadu_si256((const __m256i *) (a + i)),
+            _mm256_loadu_si256((const __m256i *) (b + i)));
+        _mm256_storeu_si256((__m256i *) (a + i), difference);
+    }
+
+    sse4_subtract(a + i, b + i, n - i);
+}
+
+#endif
+
+/* Selected kernels, scalar until select_vector_kernels() is called */
+bool (*vector_less_equal)(const int *, const int *, int) = scalar_less_equal;
+bool (*vector_difference_less_equal)(const int *, const int *, const int *,
+                                     int) = scalar_difference_less_equal;
+void (*vector_add)(int *, const int *, int) = scalar_add;
+void (*vector_subtract)(int *, const int *, int) = scalar_subtract;
+
+/* Function to select the kernels by name or by CPU support */
+const char *select_vector_kernels(const char *name) {
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+
+    if ((name == NULL || strcmp(name, "avx2") == 0) &&
+        __builtin_cpu_supports("avx2")) {
+
+        vector_less_equal = avx2_less_equal;
+        vector_difference_less_equal = avx2_difference_less_equal;
+        vector_add = avx2_add;
+        vector_subtract = avx2_subtract;
+        return "avx2";
+    }
+
+    if ((name == NULL || strcmp(name, "sse4") == 0) &&
+        __builtin_cpu_supports("sse4.1")) {
+
+        vector_less_equal = sse4_less_equal;
+        vector_difference_less_equal = sse4_difference_less_equal;
+        vector_add = sse4_add;
+        vector_subtract = sse4_subtract;
+        return "sse4";
+    }
+#endif
+
+    if (name == NULL || strcmp(name, "scalar") == 0) {
+
+        vector_less_equal = scalar_less_equal;
+        vector_difference_less_equal = scalar_difference_less_equal;
+        vector_add = scalar_add;
+        vector_subtract = scalar_subtract;
+        return "scalar";
+    }
+
+    return NULL;
+}
@@ -0,0 +1,32 @@
+/**
+ * Vector kernels for comparing and combining rows of resource counts.
+ * An AVX2, SSE4.1 or scalar implementation is selected at runtime
+ **/
+
+#ifndef VECTOR_KERNELS_H
+#define VECTOR_KERNELS_H
+
+#include <stdbool.h>
+
+/* Kernels set by select_vector_kernels(). Every kernel works on the
+ * first n ints of its arguments */
+
+/* true if a[i] <= b[i] for every i */
+extern bool (*vector_less_equal)(const int *a, const int *b, int n);
+
+/* true if a[i] - b[i] <= c[i] for every i */
+extern bool (*vector_difference_less_equal)(const int *a, const int *b,
+                                            const int *c, int n);
+
+/* a[i] = a[i] + b[i] */
+extern void (*vector_add)(int *a, const int *b, int n);
+
+/* a[i] = a[i] - b[i] */
+extern void (*vector_subtract)(int *a, const int *b, int n);
+
+/* Function to select the kernels by name ("avx2", "sse4", "scalar"), or
+ * the best supported by the CPU if name is NULL. Returns the name of the
+ * kernels selected, or NULL if the name is unknown or unsupported */
+const char *select_vector_kernels(const char *name);
+
+#endif
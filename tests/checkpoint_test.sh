@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Round trip test of --checkpoint and --restore. A run is checkpointed,
+# its step log cut in the middle of a step as a crash would leave it,
+# and the restored run must print what the uninterrupted run printed
+# from the tick it was restored at. Takes the simulator to test.
+
+bankers=${1:?usage: checkpoint_test.sh BINARY}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+fail() {
+    echo "checkpoint_test: $*"
+    exit 1
+}
+
+"$bankers" --generate=processes=2000,seed=7 > "$dir/jobs.txt" ||
+    fail "cannot generate the workload"
+"$bankers" --clock "$dir/jobs.txt" > "$dir/full.txt" ||
+    fail "the uninterrupted run failed"
+
+# checkpointing does not change what is printed
+"$bankers" --clock --checkpoint "$dir/run.ckpt" --checkpoint-interval 4000 \
+    "$dir/jobs.txt" > "$dir/checkpointed.txt" ||
+    fail "the checkpointed run failed"
+cmp -s "$dir/full.txt" "$dir/checkpointed.txt" ||
+    fail "the checkpointed run printed something else"
+
+# crash in the middle of a step of the newest log segment, the one
+# starting at the later tick
+newest="$dir/run.ckpt.log.0"
+if [ "$(od -An -t d8 -N8 "$dir/run.ckpt.log.1")" -gt \
+     "$(od -An -t d8 -N8 "$dir/run.ckpt.log.0")" ]; then
+    newest="$dir/run.ckpt.log.1"
+fi
+size=$(wc -c < "$newest")
+truncate -s $((size / 2 + 5)) "$newest"
+
+"$bankers" --clock --restore "$dir/run.ckpt" "$dir/jobs.txt" \
+    > "$dir/restored.txt" || fail "the restored run failed"
+head -n 1 "$dir/restored.txt" | grep -q "^Restored .* at tick" ||
+    fail "the checkpoint was not restored"
+
+# the rest of the run is the end of the uninterrupted one
+lines=$(($(wc -l < "$dir/restored.txt") - 1))
+tail -n "$lines" "$dir/full.txt" > "$dir/expected.txt"
+tail -n +2 "$dir/restored.txt" | cmp -s - "$dir/expected.txt" ||
+    fail "the restored run differs from the uninterrupted one"
+
+echo "checkpoint_test: ok"
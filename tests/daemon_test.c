@@ -0,0 +1,268 @@
+/**
+ * Test of the protocol of the daemon. The daemon is run on a thread of
+ * the test and jobs connect to its socket: they register, request and
+ * release, pipeline messages, wait for resources another job holds and
+ * are denied requests above their remaining need. The daemon is stopped
+ * with SIGTERM as it would be from the shell
+ **/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "allocator_daemon.h"
+#include "test_util.h"
+
+#define RESOURCES 4
+#define CAPACITY 4
+#define REPLY_TIMEOUT 5000
+
+/* Address of the socket the daemon serves on */
+static struct sockaddr_un address;
+
+/* Function run by the daemon thread */
+void *daemon_thread(void *arg) {
+
+    int total[RESOURCES] = {4, 4, 4, 4};
+
+    (void) arg;
+    CHECK(run_daemon(address.sun_path, RESOURCES, total, CAPACITY) == 0);
+    return NULL;
+}
+
+/* Function to connect a job to the daemon, retrying while it starts */
+int connect_job(void) {
+
+    int fd;
+    int attempt;
+
+    for (attempt = 0; attempt < 500; attempt++) {
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr *) &address,
+                                sizeof(address)) == 0) {
+            return fd;
+        }
+
+        close(fd);
+        usleep(10000);
+    }
+
+    CHECK(!"the daemon does not accept connections");
+    exit(finish_test("daemon_test"));
+}
+
+/* Function to send messages, one or more lines, from a job */
+void send_job(int fd, const char *messages) {
+
+    CHECK(write(fd, messages, strlen(messages)) == (ssize_t) strlen(messages));
+}
+
+/* Function to read the next reply to a job into line, waiting at most
+ * timeout milliseconds. Returns false if none came */
+bool read_reply(int fd, char *line, int size, int timeout) {
+
+    int used = 0;
+    struct pollfd event = {fd, POLLIN, 0};
+
+    while (used < size - 1) {
+
+        if (poll(&event, 1, timeout) != 1 || read(fd, line + used, 1) != 1) {
+            break;
+        }
+
+        if (line[used] == '\n') {
+            line[used] = '\0';
+            return true;
+        }
+        used++;
+    }
+
+    line[used] = '\0';
+    return false;
+}
+
+/* Function to check that the next reply to a job is expected */
+void expect_reply(int fd, const char *expected) {
+
+    char line[64];
+
+    if (!read_reply(fd, line, sizeof(line), REPLY_TIMEOUT)) {
+        strcpy(line, "(no reply)");
+    }
+    if (strcmp(line, expected) != 0) {
+        fprintf(stderr, "expected \"%s\", got \"%s\"\n", expected, line);
+        CHECK(strcmp(line, expected) == 0);
+    }
+}
+
+/* Function to check that a job gets no reply for now */
+void expect_silence(int fd) {
+
+    char line[64];
+
+    CHECK(!read_reply(fd, line, sizeof(line), 100));
+}
+
+/* Function to register a job and return its pid */
+int register_job(int fd, const char *max_need) {
+
+    int pid = -1;
+    char line[64];
+
+    send_job(fd, max_need);
+    CHECK(read_reply(fd, line, sizeof(line), REPLY_TIMEOUT));
+    CHECK(sscanf(line, "OK %d", &pid) == 1);
+    CHECK(pid >= 0 && pid < CAPACITY);
+
+    return pid;
+}
+
+/* Function to make requests, release and end jobs one message at a time */
+void test_messages(void) {
+
+    int first = connect_job();
+    int second = connect_job();
+
+    CHECK(register_job(first, "REGISTER 4 4 4 4\n") !=
+          register_job(second, "REGISTER 2 2 2 2\n"));
+
+    send_job(first, "RQ 4 4 4 4\n");
+    expect_reply(first, "GRANTED");
+
+    /* above the remaining need, then within it but held by the first */
+    send_job(second, "RQ 3 0 0 0\n");
+    expect_reply(second, "DENIED");
+    send_job(second, "RQ 1 1 1 1\n");
+    expect_reply(second, "WAIT");
+    expect_silence(second);
+
+    /* answered once the first job releases */
+    send_job(first, "RL 4 4 4 4\n");
+    expect_reply(first, "OK");
+    expect_reply(second, "GRANTED");
+
+    /* releasing more than is held, a second registration, an unknown
+     * message */
+    send_job(second, "RL 2 0 0 0\n");
+    expect_reply(second, "DENIED");
+    send_job(second, "REGISTER 1 1 1 1\n");
+    expect_reply(second, "DENIED");
+    send_job(second, "HELLO\n");
+    expect_reply(second, "ERROR unknown message");
+
+    send_job(second, "END\n");
+    expect_reply(second, "OK");
+    send_job(first, "END\n");
+    expect_reply(first, "OK");
+
+    /* a job must register first, and may not need more than the totals */
+    send_job(first, "RQ 1 0 0 0\n");
+    expect_reply(first, "DENIED");
+    send_job(first, "REGISTER 5 0 0 0\n");
+    expect_reply(first, "DENIED");
+
+    close(first);
+    close(second);
+}
+
+/* Function to send a whole job at once, answered in order */
+void test_pipelined(void) {
+
+    int fd = connect_job();
+    char line[64];
+
+    send_job(fd, "REGISTER 1 1 1 1\nRQ 1 1 1 1\nRL 1 1 1 1\nEND\n");
+    CHECK(read_reply(fd, line, sizeof(line), REPLY_TIMEOUT));
+    CHECK(strncmp(line, "OK ", 3) == 0);
+    expect_reply(fd, "GRANTED");
+    expect_reply(fd, "OK");
+    expect_reply(fd, "OK");
+
+    close(fd);
+}
+
+/* Function to make two requests that are only safe one at a time, so
+ * that one job waits for the other whether the daemon decides them in
+ * one pass or two */
+void test_unsafe_pair(void) {
+
+    int fds[2] = {connect_job(), connect_job()};
+    int granted;
+    char line[2][64];
+
+    register_job(fds[0], "REGISTER 3 3 3 3\n");
+    register_job(fds[1], "REGISTER 3 3 3 3\n");
+
+    send_job(fds[0], "RQ 2 2 2 2\n");
+    send_job(fds[1], "RQ 2 2 2 2\n");
+    CHECK(read_reply(fds[0], line[0], sizeof(line[0]), REPLY_TIMEOUT));
+    CHECK(read_reply(fds[1], line[1], sizeof(line[1]), REPLY_TIMEOUT));
+
+    granted = strcmp(line[0], "GRANTED") == 0 ? 0 : 1;
+    CHECK(strcmp(line[granted], "GRANTED") == 0);
+    CHECK(strcmp(line[1 - granted], "WAIT") == 0);
+
+    /* the granted job can still finish, and closing it lets the other
+     * through */
+    send_job(fds[granted], "RQ 1 1 1 1\n");
+    expect_reply(fds[granted], "GRANTED");
+    close(fds[granted]);
+    expect_reply(fds[1 - granted], "GRANTED");
+
+    send_job(fds[1 - granted], "END\n");
+    expect_reply(fds[1 - granted], "OK");
+    close(fds[1 - granted]);
+}
+
+int main(void) {
+
+    int out;
+    int null_fd;
+    char dir[] = "/tmp/daemon_testXXXXXX";
+    pthread_t thread;
+    sigset_t blocked;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s/bankers.sock",
+             dir);
+
+    /* only the daemon thread takes SIGTERM, and what it prints is
+     * dropped */
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+    fflush(stdout);
+    out = dup(STDOUT_FILENO);
+    null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    pthread_create(&thread, NULL, daemon_thread, NULL);
+
+    test_messages();
+    test_pipelined();
+    test_unsafe_pair();
+
+    pthread_kill(thread, SIGTERM);
+    pthread_join(thread, NULL);
+
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    close(null_fd);
+    CHECK(access(address.sun_path, F_OK) == -1);
+    rmdir(dir);
+
+    return finish_test("daemon_test");
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Differential test of the schedulers and the undo log. Every scheduler,
+# with and without admission control, and every wake policy is run with
+# --differential, which decides each request again with full safety
+# checks and scalar kernels, and every decision must match. So are
+# workloads contended enough that many tentative grants are rolled back,
+# with the specialized and the generic checks. Takes the simulator to
+# test.
+
+bankers=${1:?usage: differential_test.sh BINARY}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+# check one run of a workload against the reference, given its options
+check() {
+    jobs=$1
+    shift
+    if ! "$bankers" --clock --differential "$@" "$dir/$jobs" \
+            > "$dir/out.txt" ||
+       ! grep -q "^All .* decisions match the reference" "$dir/out.txt"; then
+        echo "differential_test: $jobs $* differs from the reference"
+        head -n 3 "$dir/out.txt"
+        failed=1
+    fi
+}
+
+"$bankers" --generate=processes=2000,priorities=4,deadlines=20000,seed=3 \
+    > "$dir/jobs.txt" || exit 1
+
+for scheduler in fifo priority srn edf; do
+    check jobs.txt --scheduler "$scheduler"
+    check jobs.txt --scheduler "$scheduler" --admission 8
+done
+for wake in all fifo priority; do
+    check jobs.txt --wake "$wake"
+done
+
+# every max need may reach the totals, so that many requests are unsafe
+for resources in 1 4 8 12; do
+    jobs=contended$resources.txt
+    settings=processes=1000,resources=$resources,contention=1.0
+    "$bankers" --generate=$settings,seed=$resources > "$dir/$jobs" || exit 1
+    if ! "$bankers" --clock --stats "$dir/$jobs" |
+            grep -q "^Rollbacks: *[1-9]"; then
+        echo "differential_test: $jobs rolls nothing back"
+        failed=1
+    fi
+    check "$jobs"
+    check "$jobs" --generic
+done
+
+[ $failed -eq 0 ] && echo "differential_test: ok"
+exit $failed
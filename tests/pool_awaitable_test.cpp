@@ -0,0 +1,98 @@
+/**
+ * Test of the C++20 awaitable for the asynchronous requests of the pool
+ * manager. A request that is decided at once resumes its coroutine
+ * without suspending it, and a pending one suspends the coroutine until
+ * a release on another thread grants the request and resumes it there
+ **/
+
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "pool_awaitable.hpp"
+
+/* Number of checks that failed */
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, \
+                     __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+/* Coroutine that runs at once and destroys itself once it returns */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::abort(); }
+    };
+};
+
+/* What a coroutine saw of its request */
+struct Outcome {
+    RmStatus status = RM_PENDING;
+    bool done = false;
+    std::thread::id resumed_on;
+};
+
+/* Function to await one request of pid and record its outcome */
+Task await_request(PoolManager *pm, int pid, const int *resources,
+                   Outcome *outcome) {
+    outcome->status = co_await PmRequest(pm, pid, resources);
+    outcome->resumed_on = std::this_thread::get_id();
+    outcome->done = true;
+}
+
+int main() {
+    int total[1] = {4};
+    int pool_of[1] = {0};
+    int max_need[1] = {4};
+    int half[1] = {2};
+    int all[1] = {4};
+    int too_much[1] = {5};
+    Outcome immediate;
+    Outcome invalid;
+    Outcome pending;
+    PoolManager *pm = pm_create(1, total, 2, 1, pool_of);
+
+    CHECK(pm != NULL);
+    CHECK(pm_register(pm, 0, max_need) == RM_GRANTED);
+    CHECK(pm_register(pm, 1, max_need) == RM_GRANTED);
+
+    /* decided at once, so the coroutine has finished on return */
+    await_request(pm, 0, half, &immediate);
+    CHECK(immediate.done && immediate.status == RM_GRANTED);
+    CHECK(immediate.resumed_on == std::this_thread::get_id());
+    await_request(pm, 0, too_much, &invalid);
+    CHECK(invalid.done && invalid.status == RM_INVALID);
+
+    /* only half is left, so the request waits for the release */
+    await_request(pm, 1, all, &pending);
+    CHECK(!pending.done);
+
+    std::thread releaser([&] {
+        CHECK(pm_release(pm, 0, half) == RM_GRANTED);
+    });
+    std::thread::id releaser_id = releaser.get_id();
+    releaser.join();
+
+    CHECK(pending.done && pending.status == RM_GRANTED);
+    CHECK(pending.resumed_on == releaser_id);
+
+    CHECK(pm_exit(pm, 0) == RM_GRANTED);
+    CHECK(pm_exit(pm, 1) == RM_GRANTED);
+    pm_destroy(pm);
+
+    if (failures > 0) {
+        std::printf("pool_awaitable_test: %d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("pool_awaitable_test: ok\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/**
+ * Test of requests across pools. A request prepared in one manager and
+ * refused by the next must be rolled back and leave the first manager
+ * unlocked, both with the managers used directly and through the pool
+ * manager, and a pending request across pools must be completed by the
+ * release in the pool that refused it
+ **/
+
+#include <stdbool.h>
+#include <string.h>
+#include "pool_manager.h"
+#include "resource_manager.h"
+#include "test_util.h"
+
+/* Function to check that the resources available in rm are expected */
+void check_available(ResourceManager *rm, int a, int b) {
+
+    int available[2];
+
+    rm_available(rm, available);
+    CHECK(available[0] == a && available[1] == b);
+}
+
+/* Function to prepare and abort a request across two managers */
+void test_prepare_abort(void) {
+
+    int total[2] = {4, 4};
+    int shared_need[2] = {2, 2};
+    int local_need[2] = {4, 4};
+    int request[2] = {1, 1};
+    int all[2] = {4, 4};
+    ResourceManager *first = rm_create(2, total, 2);
+    ResourceManager *second = rm_create(2, total, 2);
+    long fast_grants;
+    RmStats stats;
+
+    CHECK(rm_register_shared(first, 0, shared_need) == RM_GRANTED);
+    CHECK(rm_register_shared(second, 0, shared_need) == RM_GRANTED);
+    CHECK(rm_register(first, 1, local_need) == RM_GRANTED);
+    CHECK(rm_register(second, 1, local_need) == RM_GRANTED);
+
+    /* the second manager has nothing left, so the first is rolled back */
+    CHECK(rm_request(second, 1, all) == RM_GRANTED);
+    CHECK(rm_prepare(first, 0, request) == RM_GRANTED);
+    CHECK(rm_prepare(second, 0, request) == RM_UNAVAILABLE);
+    rm_abort(first, 0, request);
+    check_available(first, 4, 4);
+    check_available(second, 0, 0);
+
+    /* the first manager is unlocked, its fast path open again */
+    rm_stats(first, &stats);
+    fast_grants = stats.fast_grants;
+    CHECK(rm_request(first, 1, request) == RM_GRANTED);
+    CHECK(rm_release(first, 1, request) == RM_GRANTED);
+    rm_stats(first, &stats);
+    CHECK(stats.fast_grants == fast_grants + 1);
+
+    /* granted in both once the second has room */
+    CHECK(rm_release(second, 1, all) == RM_GRANTED);
+    CHECK(rm_prepare(first, 0, request) == RM_GRANTED);
+    CHECK(rm_prepare(second, 0, request) == RM_GRANTED);
+    rm_commit(first);
+    rm_commit(second);
+    check_available(first, 3, 3);
+    check_available(second, 3, 3);
+
+    CHECK(rm_exit(first, 0) == RM_GRANTED);
+    CHECK(rm_exit(second, 0) == RM_GRANTED);
+    check_available(first, 4, 4);
+    check_available(second, 4, 4);
+
+    rm_destroy(first);
+    rm_destroy(second);
+}
+
+/* Function to record the completion of an asynchronous request */
+void record_status(int pid, RmStatus status, void *context) {
+
+    (void) pid;
+    *(RmStatus *) context = status;
+}
+
+/* Function to deny a request across pools in the pool manager and grant
+ * it once the refusing pool has room */
+void test_pool_manager(void) {
+
+    int total[4] = {4, 4, 4, 4};
+    int pool_of[4] = {0, 0, 1, 1};
+    int shared_need[4] = {2, 2, 2, 2};
+    int second_need[4] = {0, 0, 4, 0};
+    int first_need[4] = {4, 4, 0, 0};
+    int across[4] = {1, 1, 1, 0};
+    int too_much[4] = {1, 1, 2, 0};
+    RmStatus completed = RM_PENDING;
+    PoolStats stats;
+    PoolManager *pm = pm_create(4, total, 3, 2, pool_of);
+
+    CHECK(pm != NULL);
+    CHECK(pm_register(pm, 0, shared_need) == RM_GRANTED);
+    CHECK(pm_register(pm, 1, second_need) == RM_GRANTED);
+    CHECK(pm_register(pm, 2, first_need) == RM_GRANTED);
+
+    /* the second pool refuses, so the first pool keeps nothing */
+    CHECK(pm_request(pm, 1, second_need) == RM_GRANTED);
+    CHECK(pm_request(pm, 0, across) == RM_UNAVAILABLE);
+    CHECK(pm_request(pm, 2, first_need) == RM_GRANTED);
+    CHECK(pm_release(pm, 2, first_need) == RM_GRANTED);
+
+    /* pending until the second pool gets its resource back, denied once
+     * more before it is kept pending */
+    CHECK(pm_request_async(pm, 0, across, record_status, &completed) ==
+          RM_PENDING);
+    CHECK(completed == RM_PENDING);
+    CHECK(pm_release(pm, 1, second_need) == RM_GRANTED);
+    CHECK(completed == RM_GRANTED);
+
+    /* a release above what is held is refused in every pool */
+    CHECK(pm_release(pm, 0, too_much) == RM_INVALID);
+    CHECK(pm_release(pm, 0, across) == RM_GRANTED);
+
+    pm_stats(pm, &stats);
+    CHECK(stats.shared == 1);
+    CHECK(stats.cross_grants == 1 && stats.cross_denials == 2);
+    CHECK(stats.pending == 1 && stats.stalled == 0 && stats.retries == 1);
+
+    CHECK(pm_exit(pm, 0) == RM_GRANTED);
+    CHECK(pm_exit(pm, 1) == RM_GRANTED);
+    CHECK(pm_exit(pm, 2) == RM_GRANTED);
+
+    pm_destroy(pm);
+}
+
+int main(void) {
+
+    test_prepare_abort();
+    test_pool_manager();
+
+    return finish_test("pool_cross_test");
+}
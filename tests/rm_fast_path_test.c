@@ -0,0 +1,261 @@
+/**
+ * Differential test of the packed fast path of the resource manager.
+ * The same calls are made on a manager of four resources, which keeps
+ * its available counts packed, and on one with a fifth resource of total
+ * 0 that no process needs, which decides every call under the mutex.
+ * Both must decide every call alike, as a serial Banker's algorithm
+ * would, and keep the same resources available. A request above the
+ * remaining need is refused on both paths
+ **/
+
+#include <stdbool.h>
+#include <string.h>
+#include "resource_manager.h"
+#include "test_util.h"
+
+#define RESOURCES 4
+#define PROCESSES 6
+#define CALLS 200000
+
+/* State of the serial Banker's algorithm the managers are checked with */
+typedef struct Reference {
+    int available[RESOURCES];
+    int max_need[PROCESSES][RESOURCES];
+    int allocation[PROCESSES][RESOURCES];
+    bool active[PROCESSES];
+} Reference;
+
+/* Function to check if the reference is in a safe state */
+bool reference_safe(const Reference *r) {
+
+    int i, j;
+    int work[RESOURCES];
+    bool finished[PROCESSES];
+    bool progress = true;
+
+    memcpy(work, r->available, sizeof(work));
+    for (i = 0; i < PROCESSES; i++) {
+        finished[i] = !r->active[i];
+    }
+
+    while (progress) {
+
+        progress = false;
+        for (i = 0; i < PROCESSES; i++) {
+
+            if (finished[i]) {
+                continue;
+            }
+
+            for (j = 0; j < RESOURCES; j++) {
+                if (r->max_need[i][j] - r->allocation[i][j] > work[j]) {
+                    break;
+                }
+            }
+
+            if (j == RESOURCES) {
+                for (j = 0; j < RESOURCES; j++) {
+                    work[j] += r->allocation[i][j];
+                }
+                finished[i] = true;
+                progress = true;
+            }
+        }
+    }
+
+    for (i = 0; i < PROCESSES; i++) {
+        if (!finished[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Function to decide a request within the remaining need of pid on the
+ * reference */
+RmStatus reference_request(Reference *r, int pid, const int *request) {
+
+    int j;
+
+    for (j = 0; j < RESOURCES; j++) {
+        if (request[j] > r->available[j]) {
+            return RM_UNAVAILABLE;
+        }
+    }
+
+    for (j = 0; j < RESOURCES; j++) {
+        r->available[j] -= request[j];
+        r->allocation[pid][j] += request[j];
+    }
+
+    if (reference_safe(r)) {
+        return RM_GRANTED;
+    }
+
+    for (j = 0; j < RESOURCES; j++) {
+        r->available[j] += request[j];
+        r->allocation[pid][j] -= request[j];
+    }
+
+    return RM_UNSAFE;
+}
+
+/* Function to check that a request above the max need is refused, with
+ * the resources to grant it available, and leaves nothing allocated */
+void test_above_need(ResourceManager *rm) {
+
+    int max_need[RESOURCES + 1] = {1, 1, 1, 1, 0};
+    int request[RESOURCES + 1] = {3, 0, 0, 0, 0};
+    int within[RESOURCES + 1] = {1, 0, 0, 0, 0};
+
+    CHECK(rm_register(rm, 0, max_need) == RM_GRANTED);
+    CHECK(rm_request(rm, 0, request) == RM_INVALID);
+    CHECK(rm_prepare(rm, 0, request) == RM_INVALID);
+    CHECK(rm_request(rm, 0, within) == RM_GRANTED);
+    CHECK(rm_request(rm, 0, within) == RM_INVALID);
+    CHECK(rm_release(rm, 0, within) == RM_GRANTED);
+    CHECK(rm_exit(rm, 0) == RM_GRANTED);
+}
+
+int main(void) {
+
+    int i, j, pid;
+    int call;
+    bool over;
+    int total[RESOURCES + 1] = {12, 9, 7, 10, 0};
+    int values[RESOURCES + 1];
+    int available[RESOURCES + 1];
+    unsigned long seed = 2024;
+    RmStatus packed_status;
+    RmStatus locked_status;
+    RmStatus expected;
+    RmStats packed_stats;
+    RmStats locked_stats;
+    Reference r;
+    ResourceManager *packed;
+    ResourceManager *locked;
+
+    packed = rm_create(RESOURCES, total, PROCESSES);
+    locked = rm_create(RESOURCES + 1, total, PROCESSES);
+    CHECK(packed != NULL && locked != NULL);
+
+    memset(&r, 0, sizeof(r));
+    memcpy(r.available, total, sizeof(r.available));
+    values[RESOURCES] = 0;
+
+    for (call = 0; call < CALLS; call++) {
+
+        pid = next_random(&seed, PROCESSES);
+
+        /* start a process with a random max need */
+        if (!r.active[pid]) {
+
+            for (j = 0; j < RESOURCES; j++) {
+                values[j] = next_random(&seed, total[j] + 1);
+                r.max_need[pid][j] = values[j];
+                r.allocation[pid][j] = 0;
+            }
+
+            CHECK(rm_register(packed, pid, values) == RM_GRANTED);
+            CHECK(rm_register(locked, pid, values) == RM_GRANTED);
+            r.active[pid] = true;
+            continue;
+        }
+
+        switch (next_random(&seed, 8)) {
+
+            /* end the process */
+            case 0:
+                CHECK(rm_exit(packed, pid) == RM_GRANTED);
+                CHECK(rm_exit(locked, pid) == RM_GRANTED);
+                for (j = 0; j < RESOURCES; j++) {
+                    r.available[j] += r.allocation[pid][j];
+                }
+                r.active[pid] = false;
+                break;
+
+            /* release part of what the process holds, or too much */
+            case 1:
+            case 2:
+            case 3:
+                for (j = 0; j < RESOURCES; j++) {
+                    values[j] = next_random(&seed,
+                                            r.allocation[pid][j] + 2);
+                }
+
+                packed_status = rm_release(packed, pid, values);
+                locked_status = rm_release(locked, pid, values);
+                CHECK(packed_status == locked_status);
+
+                for (j = 0; j < RESOURCES &&
+                            values[j] <= r.allocation[pid][j]; j++);
+                CHECK(packed_status ==
+                      (j == RESOURCES ? RM_GRANTED : RM_INVALID));
+
+                if (j == RESOURCES) {
+                    for (j = 0; j < RESOURCES; j++) {
+                        r.allocation[pid][j] -= values[j];
+                        r.available[j] += values[j];
+                    }
+                }
+                break;
+
+            /* request part of the remaining need, now and then above it */
+            default:
+                over = next_random(&seed, 50) == 0;
+                for (j = 0; j < RESOURCES; j++) {
+                    values[j] = next_random(&seed,
+                                            r.max_need[pid][j] -
+                                            r.allocation[pid][j] + 1);
+                }
+                if (over) {
+                    j = next_random(&seed, RESOURCES);
+                    values[j] = r.max_need[pid][j] - r.allocation[pid][j] + 1;
+                }
+
+                packed_status = rm_request(packed, pid, values);
+                locked_status = rm_request(locked, pid, values);
+                expected = over ? RM_INVALID :
+                           reference_request(&r, pid, values);
+                CHECK(packed_status == locked_status);
+                CHECK(packed_status == expected);
+                break;
+        }
+
+        rm_available(packed, available);
+        CHECK(memcmp(available, r.available, sizeof(r.available)) == 0);
+        rm_available(locked, available);
+        CHECK(memcmp(available, r.available, sizeof(r.available)) == 0);
+        CHECK(available[RESOURCES] == 0);
+
+        if (failures > 0) {
+            fprintf(stderr, "first difference at call %d\n", call);
+            break;
+        }
+    }
+
+    /* the first manager decided on the fast path, the second never did */
+    rm_stats(packed, &packed_stats);
+    rm_stats(locked, &locked_stats);
+    CHECK(packed_stats.fast_grants > 0 && packed_stats.fast_releases > 0);
+    CHECK(locked_stats.fast_grants == 0 && locked_stats.fast_releases == 0);
+    CHECK(packed_stats.fast_grants + packed_stats.slow_grants ==
+          locked_stats.slow_grants);
+    CHECK(locked_stats.unavailable > 0 && locked_stats.unsafe > 0);
+
+    for (i = 0; i < PROCESSES; i++) {
+        if (r.active[i]) {
+            rm_exit(packed, i);
+            rm_exit(locked, i);
+        }
+    }
+
+    test_above_need(packed);
+    test_above_need(locked);
+
+    rm_destroy(packed);
+    rm_destroy(locked);
+
+    return finish_test("rm_fast_path_test");
+}
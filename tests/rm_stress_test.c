@@ -0,0 +1,219 @@
+/**
+ * Stress test of the resource manager from concurrent threads. Each
+ * thread runs two processes that register, request, release and exit at
+ * random. Every round the threads stop at a barrier and one checks that
+ * the available resources and those the processes hold add up to the
+ * totals, and that the state is safe. Run on a manager that takes the
+ * fast path and on one that always locks
+ **/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "resource_manager.h"
+#include "test_util.h"
+
+#define MAX_RESOURCES 6
+#define THREADS 4
+#define PROCESSES_PER_THREAD 2
+#define PROCESSES (THREADS * PROCESSES_PER_THREAD)
+#define ROUNDS 1000
+#define CALLS_PER_ROUND 500
+
+/* Processes as their threads see them, read by the checker only while
+ * every thread waits at the barrier */
+typedef struct StressState {
+    ResourceManager *rm;
+    int num_resources;
+    int total[MAX_RESOURCES];
+    int max_need[PROCESSES][MAX_RESOURCES];
+    int allocation[PROCESSES][MAX_RESOURCES];
+    bool active[PROCESSES];
+    pthread_barrier_t barrier;
+} StressState;
+
+static StressState state;
+
+/* Function to check that the available resources and the allocations add
+ * up to the totals and that every process can finish in some order */
+void check_state(void) {
+
+    int i, j;
+    int available[MAX_RESOURCES];
+    int work[MAX_RESOURCES];
+    int sum;
+    bool finished[PROCESSES];
+    bool progress = true;
+
+    rm_available(state.rm, available);
+
+    for (j = 0; j < state.num_resources; j++) {
+
+        sum = available[j];
+        for (i = 0; i < PROCESSES; i++) {
+            sum += state.allocation[i][j];
+        }
+
+        CHECK(available[j] >= 0);
+        CHECK(sum == state.total[j]);
+    }
+
+    memcpy(work, available, sizeof(work));
+    for (i = 0; i < PROCESSES; i++) {
+        finished[i] = !state.active[i];
+    }
+
+    while (progress) {
+
+        progress = false;
+        for (i = 0; i < PROCESSES; i++) {
+
+            if (finished[i]) {
+                continue;
+            }
+
+            for (j = 0; j < state.num_resources; j++) {
+                if (state.max_need[i][j] - state.allocation[i][j] > work[j]) {
+                    break;
+                }
+            }
+
+            if (j == state.num_resources) {
+                for (j = 0; j < state.num_resources; j++) {
+                    work[j] += state.allocation[i][j];
+                }
+                finished[i] = true;
+                progress = true;
+            }
+        }
+    }
+
+    for (i = 0; i < PROCESSES; i++) {
+        CHECK(finished[i]);
+    }
+}
+
+/* Function to make one random call for process pid */
+void stress_call(int pid, unsigned long *seed) {
+
+    int j;
+    int values[MAX_RESOURCES];
+    int *max_need = state.max_need[pid];
+    int *allocation = state.allocation[pid];
+
+    if (!state.active[pid]) {
+
+        for (j = 0; j < state.num_resources; j++) {
+            max_need[j] = next_random(seed, state.total[j] / 2 + 1);
+            allocation[j] = 0;
+        }
+
+        CHECK(rm_register(state.rm, pid, max_need) == RM_GRANTED);
+        state.active[pid] = true;
+        return;
+    }
+
+    switch (next_random(seed, 10)) {
+
+        case 0:
+            CHECK(rm_exit(state.rm, pid) == RM_GRANTED);
+            memset(allocation, 0, MAX_RESOURCES * sizeof(int));
+            state.active[pid] = false;
+            break;
+
+        case 1:
+        case 2:
+        case 3:
+            for (j = 0; j < state.num_resources; j++) {
+                values[j] = next_random(seed, allocation[j] + 1);
+            }
+
+            CHECK(rm_release(state.rm, pid, values) == RM_GRANTED);
+            for (j = 0; j < state.num_resources; j++) {
+                allocation[j] -= values[j];
+            }
+            break;
+
+        default:
+            for (j = 0; j < state.num_resources; j++) {
+                values[j] = next_random(seed, max_need[j] - allocation[j] + 1);
+            }
+
+            if (rm_request(state.rm, pid, values) == RM_GRANTED) {
+                for (j = 0; j < state.num_resources; j++) {
+                    allocation[j] += values[j];
+                }
+            }
+            break;
+    }
+}
+
+/* Function run by each thread, making calls for its processes and
+ * stopping at the barrier between rounds */
+void *stress_thread(void *arg) {
+
+    int slot = (int) (intptr_t) arg;
+    int round;
+    int call;
+    unsigned long seed = 7919 * (slot + 1);
+
+    for (round = 0; round < ROUNDS; round++) {
+
+        for (call = 0; call < CALLS_PER_ROUND; call++) {
+            stress_call(slot * PROCESSES_PER_THREAD +
+                        next_random(&seed, PROCESSES_PER_THREAD), &seed);
+        }
+
+        /* one thread checks while the others wait */
+        if (pthread_barrier_wait(&state.barrier) ==
+            PTHREAD_BARRIER_SERIAL_THREAD) {
+            check_state();
+        }
+        pthread_barrier_wait(&state.barrier);
+    }
+
+    return NULL;
+}
+
+/* Function to stress a manager of num_resources resources */
+void run_stress(int num_resources, const int *total, bool fast_path) {
+
+    int i;
+    pthread_t threads[THREADS];
+    RmStats stats;
+
+    memset(&state, 0, sizeof(state));
+    state.num_resources = num_resources;
+    memcpy(state.total, total, num_resources * sizeof(int));
+    state.rm = rm_create(num_resources, total, PROCESSES);
+    pthread_barrier_init(&state.barrier, NULL, THREADS);
+
+    for (i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, stress_thread,
+                       (void *) (intptr_t) i);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    check_state();
+
+    rm_stats(state.rm, &stats);
+    CHECK(stats.slow_grants > 0 && stats.unavailable + stats.unsafe > 0);
+    CHECK(fast_path ? stats.fast_grants > 0 : stats.fast_grants == 0);
+
+    pthread_barrier_destroy(&state.barrier);
+    rm_destroy(state.rm);
+}
+
+int main(void) {
+
+    int packed_total[4] = {10, 12, 8, 9};
+    int locked_total[MAX_RESOURCES] = {10, 12, 8, 9, 7, 11};
+
+    run_stress(4, packed_total, true);
+    run_stress(MAX_RESOURCES, locked_total, false);
+
+    return finish_test("rm_stress_test");
+}
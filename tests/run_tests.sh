@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# Builds the simulator and the tests and runs them all. Run from the top
+# of the repository; exits with status 1 if any test fails. Every
+# tests/*_test.c is linked with the sources of the simulator but its
+# main, every tests/*_test.cpp too if a C++20 compiler is found, and
+# every tests/*_test.sh is given the simulator to run.
+
+cc=${CC:-gcc}
+cxx=${CXX:-g++}
+cflags="-O2 -Wall -Wextra -pthread -Isrc"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+$cc $cflags -o "$dir/bankers" src/*.c || exit 1
+
+# the tests only pull in the objects they use
+for source in src/*.c; do
+    [ "$source" = src/bankers_algorithm.c ] && continue
+    $cc $cflags -c -o "$dir/$(basename "$source" .c).o" "$source" || exit 1
+done
+ar rcs "$dir/libbankers.a" "$dir"/*.o || exit 1
+
+for source in tests/*_test.c; do
+    [ -e "$source" ] || continue
+    test=$(basename "$source" .c)
+    $cc $cflags -o "$dir/$test" "$source" "$dir/libbankers.a" || exit 1
+    "$dir/$test" || failed=1
+done
+
+for source in tests/*_test.cpp; do
+    [ -e "$source" ] || continue
+    test=$(basename "$source" .cpp)
+    if ! command -v "$cxx" > /dev/null; then
+        echo "$test: skipped, no C++ compiler"
+        continue
+    fi
+    $cxx -std=c++20 -O2 -Wall -Wextra -pthread -Isrc -o "$dir/$test" \
+        "$source" "$dir/libbankers.a" || exit 1
+    "$dir/$test" || failed=1
+done
+
+for script in tests/*_test.sh; do
+    [ -e "$script" ] || continue
+    sh "$script" "$dir/bankers" || failed=1
+done
+
+exit $failed
@@ -0,0 +1,43 @@
+/**
+ * Helpers shared by the tests: a check that reports the failing line and
+ * a small seeded generator so that every run makes the same calls
+ **/
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Number of checks that failed in this test, from any thread */
+static _Atomic int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition); \
+        failures++; \
+    } \
+} while (0)
+
+/* Function to draw the next number in [0, bound) from state */
+static inline int next_random(unsigned long *state, int bound) {
+
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return bound <= 0 ? 0 : (int) ((*state >> 33) % (unsigned long) bound);
+}
+
+/* Function to report the result of a test and pick its exit status */
+static inline int finish_test(const char *name) {
+
+    if (failures > 0) {
+        printf("%s: %d checks failed\n", name, failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: ok\n", name);
+    return EXIT_SUCCESS;
+}
+
+#endif